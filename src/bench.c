@@ -0,0 +1,274 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "../lib/string.h"
+#include "lib/io_fuzzer.h"
+#include "lib/trace.h"
+#include "lib/tsc.h"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sys/io.h>
+#include <unistd.h>
+
+#define PROGRAM_NAME "iofuzzer-bench"
+
+#define ITERATIONS 100000
+#define MAX_PORTS 65536
+#define NUM_OPERATIONS 4096
+#define REPETITIONS 5
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]...\n" \
+            "Measure the operations per second of the I/O address space fuzzer at each log\n" \
+            "level, performing the same pre-decoded scalar operations and logging binary\n" \
+            "records to the output file.\n" \
+            "Options:\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -n, --iterations=NUM  Specify the number of operations performed at each log\n" \
+            "                        level in each repetition. (The default is 100000.)\n" \
+            "  -o, --output=FILE     Specify the output file name. (The default is\n" \
+            "                        /dev/null.)\n" \
+            "  -p, --ports=LIST      Specify the list of I/O port addresses.\n" \
+            "  -r, --repetitions=NUM Specify the number of repetitions at each log level.\n" \
+            "                        (The default is 5.)\n" \
+            "  -s, --seed=NUM        Specify the seed for the pseudorandom number generator.\n" \
+            "                        (The default is 1.)\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+static const char *level_names[] = {
+    "quiet",
+    "normal",
+    "verbose",
+    "debug",
+};
+
+static const int scalar_functions[] = {
+    IO_FUZZER_IO_READ16,
+    IO_FUZZER_IO_READ32,
+    IO_FUZZER_IO_READ8,
+    IO_FUZZER_IO_WRITE16,
+    IO_FUZZER_IO_WRITE32,
+    IO_FUZZER_IO_WRITE8,
+};
+
+void
+bench_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    if (trace_writer_write((trace_writer_t *)context, record) == -1) {
+        perror("trace_writer_write");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Logs and performs the operations in turn at a log level, as
+ * io_fuzzer_iterate() does after decoding each one.
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] operations Operations.
+ * @param [in] level Log level.
+ * @param [in] iterations Number of operations performed.
+ * @return Time elapsed, in seconds.
+ */
+double
+bench(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *operations, int level, uint64_t iterations)
+{
+    io_fuzzer_set_log_level(level);
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const io_fuzzer_operation_t *operation = &operations[i % NUM_OPERATIONS];
+        if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            io_fuzzer_log_operation(io_fuzzer, operation);
+        }
+
+        io_fuzzer_execute(io_fuzzer, operation);
+        io_fuzzer_log_responses(io_fuzzer);
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    io_fuzzer_set_log_level(IO_FUZZER_LOG_NORMAL);
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"help",        no_argument,       NULL, 'h'             },
+        {"iterations",  required_argument, NULL, 'n'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"ports",       required_argument, NULL, 'p'             },
+        {"repetitions", required_argument, NULL, 'r'             },
+        {"seed",        required_argument, NULL, 's'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    uint64_t iterations = ITERATIONS;
+    char *output = "/dev/null";
+    int *ports = NULL;
+    size_t num_ports = 0;
+    size_t repetitions = REPETITIONS;
+    unsigned int seed = 1;
+    while ((c = getopt_long(argc, argv, "hn:o:p:r:s:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'n':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'p':
+            if (string_split_range(optarg, ",", MAX_PORTS, &ports, &num_ports) == -1) {
+                perror("getlist");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'r':
+            repetitions = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Operations on all ports are not safe outside of a dedicated virtual machine. */
+    if (ports == NULL || iterations == 0 || repetitions == 0) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    /* The operations are decoded before the timed loops, so that only logging and performing them are measured. */
+    io_fuzzer_operation_t *operations = (io_fuzzer_operation_t *)calloc(NUM_OPERATIONS, sizeof(*operations));
+    double *rates = (double *)calloc(repetitions * (IO_FUZZER_LOG_DEBUG + 1), sizeof(*rates));
+    if (operations == NULL || rates == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    srandom(seed);
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        io_fuzzer_operation_t *operation = &operations[i];
+        operation->function = scalar_functions[random() % (sizeof(scalar_functions) / sizeof(*scalar_functions))];
+        operation->port = ports[random() % num_ports];
+        if (operation->function >= IO_FUZZER_IO_WRITE16) {
+            operation->value = random() & (UINT32_MAX >> (32 - (8 * io_fuzzer_function_width(operation->function))));
+        }
+    }
+
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror(output);
+        exit(EXIT_FAILURE);
+    }
+
+    trace_header_t header;
+    trace_header_init(&header, 0, seed);
+    trace_writer_t *writer = trace_writer_create(fd, &header);
+    if (writer == NULL) {
+        perror("trace_writer_create");
+        exit(EXIT_FAILURE);
+    }
+
+#ifndef IO_DRY_RUN
+    if (iopl(3) == -1) {
+        perror("iopl");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    tsc_clock_t clock;
+    tsc_clock_init(&clock, tsc_calibrate());
+    io_fuzzer_t *io_fuzzer = io_fuzzer_create(ports, num_ports);
+    if (io_fuzzer == NULL) {
+        perror("io_fuzzer_create");
+        exit(EXIT_FAILURE);
+    }
+
+    io_fuzzer_set_clock(io_fuzzer, &clock);
+    io_fuzzer_set_log_handler(io_fuzzer, bench_log_handler);
+    io_fuzzer_set_log_context(io_fuzzer, writer);
+    /* The levels are interleaved in each repetition, so that drift (e.g., of the CPU frequency) affects all of them. */
+    for (size_t i = 0; i < repetitions; ++i) {
+        for (int level = IO_FUZZER_LOG_QUIET; level <= IO_FUZZER_MAX_LOG_LEVEL; ++level) {
+            double seconds = bench(io_fuzzer, operations, level, iterations);
+            rates[(level * repetitions) + i] = iterations / seconds;
+        }
+    }
+
+    for (int level = IO_FUZZER_LOG_QUIET; level <= IO_FUZZER_LOG_DEBUG; ++level) {
+        if (level > IO_FUZZER_MAX_LOG_LEVEL) {
+            printf("%s: not compiled in (IO_FUZZER_MAX_LOG_LEVEL)\n", level_names[level]);
+            continue;
+        }
+
+        double *level_rates = &rates[level * repetitions];
+        qsort(level_rates, repetitions, sizeof(*level_rates), compare_doubles);
+        double median = (repetitions % 2 != 0)
+                ? level_rates[repetitions / 2]
+                : (level_rates[(repetitions / 2) - 1] + level_rates[repetitions / 2]) / 2;
+        double min = level_rates[0];
+        double max = level_rates[repetitions - 1];
+        printf("%s: %llu operations x %zu, median %.1f operations/s (%.1f ns/operation), min %.1f, max %.1f, spread "
+               "%.1f%%\n",
+                level_names[level], (unsigned long long)iterations, repetitions, median, 1e9 / median, min, max,
+                100 * (max - min) / median);
+    }
+
+    io_fuzzer_destroy(io_fuzzer);
+    trace_writer_destroy(writer);
+    close(fd);
+    free(rates);
+    free(operations);
+    free(ports);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,119 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "lib/trace.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROGRAM_NAME "iofuzzer-decode"
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]... [FILE]...\n" \
+            "Decode binary trace files as JSON lines.\n" \
+            "Options:\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -o, --output=FILE     Specify the output file name.\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+int
+decode(FILE *restrict input, FILE *restrict output)
+{
+    trace_header_t header;
+    if (trace_read_header(input, &header) == -1) {
+        return -1;
+    }
+
+    trace_record_t record;
+    int result = 0;
+    while ((result = trace_read_record(input, &header, &record)) == 1) {
+        trace_record_print_json(output, &header, &record);
+    }
+
+    return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"help",        no_argument,       NULL, 'h'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    char *output = NULL;
+    while ((c = getopt_long(argc, argv, "ho:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    FILE *stream = stdout;
+    if (output != NULL) {
+        stream = fopen(output, "w");
+        if (stream == NULL) {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int status = EXIT_SUCCESS;
+    if (optind == argc) {
+        if (decode(stdin, stream) == -1) {
+            perror("stdin");
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        FILE *input = fopen(argv[i], "r");
+        if (input == NULL) {
+            perror(argv[i]);
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        if (decode(input, stream) == -1) {
+            perror(argv[i]);
+            status = EXIT_FAILURE;
+        }
+
+        fclose(input);
+    }
+
+    fclose(stream);
+    exit(status);
+}
@@ -0,0 +1,425 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "lib/blob.h"
+#include "lib/io_fuzzer.h"
+#include "lib/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define PROGRAM_NAME "iofuzzer-import"
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]... -o DIR [FILE]...\n" \
+            "Import QEMU cpu_in/cpu_out trace events, qtest scripts (or logs), and ftrace output\n" \
+            "as a corpus of deduplicated binary traces, one per file (or per number of\n" \
+            "operations).\n" \
+            "Options:\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -n, --count=NUM       Specify the maximum number of operations of each trace.\n" \
+            "                        (The default is 0, for all operations of each file.)\n" \
+            "  -o, --output=DIR      Specify the output directory.\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+/** Results of parsing a line. */
+enum {
+    LINE_NONE,        /**< Not an access (e.g., a qtest response). */
+    LINE_OPERATION,   /**< I/O port access. */
+    LINE_UNSUPPORTED, /**< MMIO or memory access, which cannot be performed by the fuzzer. */
+};
+
+/** Corpus being imported. */
+typedef struct _corpus {
+    const char *directory;
+    size_t max_records;
+    trace_header_t header;
+    trace_record_t *records;
+    size_t num_records;
+    size_t capacity;
+    uint64_t num_operations;
+    uint64_t num_unsupported;
+    uint64_t num_traces;
+    uint64_t num_duplicates;
+} corpus_t;
+
+static int
+function_from_access(int write, int size)
+{
+    switch (size) {
+    case 'b':
+    case 1:
+        return write ? IO_FUZZER_IO_WRITE8 : IO_FUZZER_IO_READ8;
+
+    case 'w':
+    case 2:
+        return write ? IO_FUZZER_IO_WRITE16 : IO_FUZZER_IO_READ16;
+
+    case 'l':
+    case 4:
+        return write ? IO_FUZZER_IO_WRITE32 : IO_FUZZER_IO_READ32;
+
+    default:
+        return -1;
+    }
+}
+
+static int
+parse_trace_event(char *line, trace_record_t *restrict record)
+{
+    /* Log backend (e.g., "1234@1700000000.123456:cpu_out addr 0x70(b) value 10"). */
+    unsigned long long seconds = 0;
+    unsigned long long microseconds = 0;
+    if (sscanf(line, "%*u@%llu.%llu:", &seconds, &microseconds) == 2) {
+        record->time = (seconds * 1000000000ULL) + (microseconds * 1000);
+    }
+
+    char *event = strstr(line, "cpu_out ");
+    int write = (event != NULL);
+    if (event == NULL) {
+        event = strstr(line, "cpu_in ");
+    }
+
+    if (event == NULL) {
+        return LINE_NONE;
+    }
+
+    event = strchr(event, ' ') + 1;
+    unsigned int port = 0;
+    unsigned int value = 0;
+    char size = 0;
+    int function = -1;
+    if (sscanf(event, "addr %x(%c) value %u", &port, &size, &value) == 3) {
+        function = function_from_access(write, size);
+    } else {
+        /* Simple backend, as printed by simpletrace.py (e.g., "cpu_out 0.123 pid=1234 addr=0x70 size=0x62 val=0xa"). */
+        char *addr = strstr(event, "addr=");
+        char *size_str = strstr(event, "size=");
+        char *val = strstr(event, "val=");
+        if (addr != NULL && size_str != NULL && val != NULL) {
+            port = strtoul(addr + 5, NULL, 0);
+            value = strtoul(val + 4, NULL, 0);
+            function = function_from_access(write, strtoul(size_str + 5, NULL, 0));
+        }
+    }
+
+    if (function == -1 || port > UINT16_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    record->function = function;
+    record->port = port;
+    record->value = write ? value : 0;
+    return LINE_OPERATION;
+}
+
+static int
+parse_qtest(char *line, trace_record_t *restrict record)
+{
+    /* qtest log (e.g., "[R +0.001234] outb 0x70 0xa"), with the responses (i.e., "[S +0.001240] OK"). */
+    if (line[0] == '[') {
+        double seconds = 0;
+        if (line[1] != 'R') {
+            return LINE_NONE;
+        }
+
+        char *end = strchr(line, ']');
+        if (end == NULL) {
+            return LINE_NONE;
+        }
+
+        if (sscanf(line, "[R +%lf]", &seconds) == 1) {
+            record->time = seconds * 1000000000.0;
+        }
+
+        line = end + 1;
+    }
+
+    char command[16];
+    unsigned long long port = 0;
+    unsigned long long value = 0;
+    int n = sscanf(line, " %15s %lli %lli", command, &port, &value);
+    if (n < 1) {
+        return LINE_NONE;
+    }
+
+    /* Only inb, inw, inl, outb, outw, and outl are operations; other tokens (e.g., "int" in a log) are not. */
+    int write = strncmp(command, "out", 3) == 0;
+    const char *suffix = command + (write ? 3 : 2);
+    if ((write || strncmp(command, "in", 2) == 0) && suffix[0] != '\0' && strchr("bwl", suffix[0]) != NULL
+            && suffix[1] == '\0') {
+        int function = function_from_access(write, suffix[0]);
+        uint64_t max_value = UINT32_MAX >> (32 - (8 * io_fuzzer_function_width(function)));
+        if (n < (write ? 3 : 2) || port > UINT16_MAX || value > max_value) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        record->function = function;
+        record->port = port;
+        record->value = write ? value : 0;
+        return LINE_OPERATION;
+    }
+
+    if (strncmp(command, "read", 4) == 0 || strncmp(command, "write", 5) == 0 || strncmp(command, "b64", 3) == 0
+            || strcmp(command, "memset") == 0) {
+        return LINE_UNSUPPORTED;
+    }
+
+    /* Other commands (e.g., clock_step and irq_intercept_in) do not access the device. */
+    return LINE_NONE;
+}
+
+/**
+ * Parses a line of QEMU trace events, qtest scripts or logs, or ftrace output.
+ *
+ * @param [in] line Line.
+ * @param [out] record Trace record.
+ * @return LINE_NONE, LINE_OPERATION, or LINE_UNSUPPORTED; otherwise, -1 and
+ *   errno is set to indicate the error.
+ */
+static int
+parse_line(char *line, trace_record_t *restrict record)
+{
+    memset(record, 0, sizeof(*record));
+    if (strstr(line, "cpu_in ") != NULL || strstr(line, "cpu_out ") != NULL) {
+        return parse_trace_event(line, record);
+    }
+
+    /* MMIO accesses of drivers (i.e., ftrace rwmmio events) and of QEMU memory regions. */
+    if (strstr(line, "rwmmio_") != NULL || strstr(line, "memory_region_ops_") != NULL) {
+        return LINE_UNSUPPORTED;
+    }
+
+    return parse_qtest(line, record);
+}
+
+static int
+corpus_flush(corpus_t *restrict corpus)
+{
+    if (corpus->num_records == 0) {
+        return 0;
+    }
+
+    /* Traces are named by the hash of their operations, so that the same operations are only stored once. */
+    uint64_t hash = 0;
+    for (size_t i = 0; i < corpus->num_records; ++i) {
+        const trace_record_t *record = &corpus->records[i];
+        uint64_t key[2] = {hash, ((uint64_t)record->function << 48) | ((uint64_t)record->port << 32) | record->value};
+        hash = blob_hash(key, sizeof(key));
+    }
+
+    size_t num_records = corpus->num_records;
+    corpus->num_records = 0;
+    char filename[PATH_MAX];
+    if (snprintf(filename, sizeof(filename), "%s/%016llx", corpus->directory, (unsigned long long)hash)
+            >= (int)sizeof(filename)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = open(filename, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            ++corpus->num_duplicates;
+            return 0;
+        }
+
+        return -1;
+    }
+
+    trace_writer_t *writer = trace_writer_create(fd, &corpus->header);
+    if (writer == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < num_records && result == 0; ++i) {
+        corpus->records[i].sequence = i;
+        result = trace_writer_write(writer, &corpus->records[i]);
+    }
+
+    if (result == 0) {
+        result = trace_writer_flush(writer);
+    }
+
+    trace_writer_destroy(writer);
+    if (close(fd) == -1 || result == -1) {
+        unlink(filename);
+        return -1;
+    }
+
+    ++corpus->num_traces;
+    return 0;
+}
+
+static int
+corpus_add(corpus_t *restrict corpus, const trace_record_t *restrict record)
+{
+    if (corpus->num_records == corpus->capacity) {
+        size_t capacity = (corpus->capacity == 0) ? 1024 : (corpus->capacity * 2);
+        trace_record_t *records = (trace_record_t *)realloc(corpus->records, capacity * sizeof(*records));
+        if (records == NULL) {
+            return -1;
+        }
+
+        corpus->records = records;
+        corpus->capacity = capacity;
+    }
+
+    trace_record_t *new_record = &corpus->records[corpus->num_records++];
+    *new_record = *record;
+    new_record->width = io_fuzzer_function_width(record->function);
+    ++corpus->num_operations;
+    if (corpus->max_records != 0 && corpus->num_records == corpus->max_records) {
+        return corpus_flush(corpus);
+    }
+
+    return 0;
+}
+
+int
+import(FILE *restrict input, corpus_t *restrict corpus, uint64_t *line_number)
+{
+    char *line = NULL;
+    size_t size = 0;
+    int result = 0;
+    *line_number = 0;
+    while (getline(&line, &size, input) != -1) {
+        ++*line_number;
+        trace_record_t record;
+        result = parse_line(line, &record);
+        if (result == -1) {
+            break;
+        }
+
+        if (result == LINE_UNSUPPORTED) {
+            ++corpus->num_unsupported;
+        } else if (result == LINE_OPERATION && corpus_add(corpus, &record) == -1) {
+            result = -1;
+            break;
+        }
+    }
+
+    free(line);
+    if (result == -1 || ferror(input)) {
+        corpus->num_records = 0;
+        return -1;
+    }
+
+    /* Each file is a trace of its own (or the last one of its traces). */
+    return corpus_flush(corpus);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"count",       required_argument, NULL, 'n'             },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    corpus_t corpus;
+    memset(&corpus, 0, sizeof(corpus));
+    while ((c = getopt_long(argc, argv, "hn:o:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'n':
+            errno = 0;
+            corpus.max_records = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'o':
+            corpus.directory = optarg;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (corpus.directory == NULL) {
+        fprintf(stderr, "%s: an output directory is required\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (mkdir(corpus.directory, 0777) == -1 && errno != EEXIST) {
+        perror(corpus.directory);
+        exit(EXIT_FAILURE);
+    }
+
+    trace_header_init(&corpus.header, 0, 0);
+    int status = EXIT_SUCCESS;
+    uint64_t line_number = 0;
+    if (optind == argc) {
+        if (import(stdin, &corpus, &line_number) == -1) {
+            fprintf(stderr, "%s: stdin:%llu: %s\n", argv[0], (unsigned long long)line_number, strerror(errno));
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        FILE *input = fopen(argv[i], "r");
+        if (input == NULL) {
+            perror(argv[i]);
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        if (import(input, &corpus, &line_number) == -1) {
+            fprintf(stderr, "%s: %s:%llu: %s\n", argv[0], argv[i], (unsigned long long)line_number, strerror(errno));
+            status = EXIT_FAILURE;
+        }
+
+        fclose(input);
+    }
+
+    fprintf(stderr,
+            "import: %llu operations, %llu traces written, %llu duplicates, %llu MMIO or memory accesses skipped\n",
+            (unsigned long long)corpus.num_operations, (unsigned long long)corpus.num_traces,
+            (unsigned long long)corpus.num_duplicates, (unsigned long long)corpus.num_unsupported);
+    free(corpus.records);
+    exit(status);
+}
@@ -0,0 +1,481 @@
+/** @file */
+
+#include "archive.h"
+
+#include "blob.h"
+#include "io_fuzzer.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#define MAX_BLOCK_RECORDS (1024 * 1024)
+#define MAX_ENCODED_RECORD 64
+
+struct _archive {
+    int fd;
+    archive_header_t header;
+    archive_index_t *index;
+    size_t num_blocks;
+    uint8_t *buffer;
+};
+
+struct _archive_writer {
+    int fd;
+    archive_header_t header;
+    archive_index_t *index;
+    size_t num_blocks;
+    off_t offset;
+    trace_record_t previous;
+    archive_block_t block;
+    uint64_t position;
+    uint64_t digest;
+    uint8_t *buffer;
+};
+
+static inline uint64_t
+zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t
+zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static inline uint8_t *
+varint_encode(uint8_t *p, uint64_t value)
+{
+    while (value >= 0x80) {
+        *p++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static inline const uint8_t *
+varint_decode(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+static int
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+    const uint8_t *ptr = (const uint8_t *)buf;
+    while (count > 0) {
+        ssize_t result = pwrite(fd, ptr, count, offset);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        ptr += result;
+        count -= result;
+        offset += result;
+    }
+
+    return 0;
+}
+
+static int
+archive_index_append(archive_index_t **index, size_t *num_blocks, off_t offset, const archive_block_t *block)
+{
+    if ((*num_blocks & (*num_blocks - 1)) == 0) {
+        size_t capacity = (*num_blocks == 0) ? 1 : (*num_blocks * 2);
+        archive_index_t *new_index = (archive_index_t *)realloc(*index, capacity * sizeof(*new_index));
+        if (new_index == NULL) {
+            return -1;
+        }
+
+        *index = new_index;
+    }
+
+    archive_index_t *entry = &(*index)[(*num_blocks)++];
+    memset(entry, 0, sizeof(*entry));
+    entry->offset = offset;
+    entry->sequence = block->sequence;
+    entry->time = block->time;
+    entry->position = block->position;
+    entry->digest = block->digest;
+    entry->num_records = block->num_records;
+    return 0;
+}
+
+static int
+archive_rebuild_index(archive_t *restrict archive)
+{
+    off_t size = lseek(archive->fd, 0, SEEK_END);
+    if (size == -1) {
+        return -1;
+    }
+
+    off_t offset = sizeof(archive->header);
+    archive_block_t block;
+    while (offset + (off_t)sizeof(block) <= size) {
+        if (pread(archive->fd, &block, sizeof(block), offset) != sizeof(block)) {
+            return -1;
+        }
+
+        if (block.num_records == 0 || block.num_records > archive->header.block_records
+                || block.size > (uint64_t)(size - offset - sizeof(block))) {
+            /* Truncated block of an interrupted run. */
+            break;
+        }
+
+        if (archive_index_append(&archive->index, &archive->num_blocks, offset, &block) == -1) {
+            return -1;
+        }
+
+        offset += sizeof(block) + block.size;
+    }
+
+    return 0;
+}
+
+void
+archive_close(archive_t *restrict archive)
+{
+    if (archive == NULL) {
+        return;
+    }
+
+    free(archive->buffer);
+    free(archive->index);
+    free(archive);
+}
+
+int
+archive_digest(const trace_header_t *restrict header, const trace_record_t *restrict record, uint64_t *digest)
+{
+    int hashed = (header->flags & TRACE_FLAG_PAYLOAD_HASH) != 0;
+    switch (record->function) {
+    case IO_FUZZER_IO_WRITE_STRING16:
+    case IO_FUZZER_IO_WRITE_STRING32:
+    case IO_FUZZER_IO_WRITE_STRING8:
+    case TRACE_FUNCTION_RESPONSE:
+    case TRACE_FUNCTION_RESPONSE_STRING:
+        break;
+
+    default:
+        if (record->function >= IO_FUZZER_NUM_FUNCTIONS) {
+            return 0;
+        }
+
+        /* Only string writes and responses have payloads. */
+        hashed = 0;
+        break;
+    }
+
+    /* Addresses of strings differ between runs, so payloads are only compared if they are hashes. */
+    uint64_t key[4] = {*digest, ((uint64_t)record->function << 16) | record->port,
+            ((uint64_t)record->count << 32) | record->value, hashed ? record->payload : 0};
+    *digest = blob_hash(key, sizeof(key));
+    return 1;
+}
+
+size_t
+archive_find_position(const archive_t *restrict archive, uint64_t position)
+{
+    size_t low = 0;
+    size_t high = archive->num_blocks;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (archive->index[middle].position <= position) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+size_t
+archive_find_sequence(const archive_t *restrict archive, uint64_t sequence)
+{
+    size_t low = 0;
+    size_t high = archive->num_blocks;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (archive->index[middle].sequence <= sequence) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+size_t
+archive_find_time(const archive_t *restrict archive, uint64_t time)
+{
+    size_t low = 0;
+    size_t high = archive->num_blocks;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (archive->index[middle].time <= time) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+const archive_header_t *
+archive_get_header(const archive_t *restrict archive)
+{
+    return &archive->header;
+}
+
+const archive_index_t *
+archive_get_index(const archive_t *restrict archive, size_t *num_blocks)
+{
+    *num_blocks = archive->num_blocks;
+    return archive->index;
+}
+
+archive_t *
+archive_open(int fd)
+{
+    archive_t *archive = (archive_t *)calloc(1, sizeof(*archive));
+    if (archive == NULL) {
+        return NULL;
+    }
+
+    archive->fd = fd;
+    archive_header_t *header = &archive->header;
+    if (pread(fd, header, sizeof(*header), 0) != sizeof(*header)
+            || memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != ARCHIVE_VERSION || header->block_records == 0
+            || header->block_records > MAX_BLOCK_RECORDS) {
+        errno = EINVAL;
+        goto err;
+    }
+
+    archive->buffer = (uint8_t *)malloc(header->block_records * MAX_ENCODED_RECORD);
+    if (archive->buffer == NULL) {
+        goto err;
+    }
+
+    if (header->index_offset != 0) {
+        archive->index = (archive_index_t *)calloc(header->num_blocks, sizeof(*archive->index));
+        if (archive->index == NULL && header->num_blocks != 0) {
+            goto err;
+        }
+
+        ssize_t size = header->num_blocks * sizeof(*archive->index);
+        if (pread(fd, archive->index, size, header->index_offset) == size) {
+            archive->num_blocks = header->num_blocks;
+            return archive;
+        }
+
+        /* Truncated archive; the index is rebuilt from the remaining blocks. */
+        free(archive->index);
+        archive->index = NULL;
+    }
+
+    if (archive_rebuild_index(archive) == -1) {
+        goto err;
+    }
+
+    return archive;
+
+err:
+    archive_close(archive);
+    return NULL;
+}
+
+ssize_t
+archive_read_block(archive_t *restrict archive, size_t block, trace_record_t *restrict records)
+{
+    if (block >= archive->num_blocks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    archive_block_t block_header;
+    off_t offset = archive->index[block].offset;
+    if (pread(archive->fd, &block_header, sizeof(block_header), offset) != sizeof(block_header)
+            || block_header.num_records > archive->header.block_records
+            || block_header.size > archive->header.block_records * MAX_ENCODED_RECORD) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pread(archive->fd, archive->buffer, block_header.size, offset + sizeof(block_header))
+            != (ssize_t)block_header.size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const uint8_t *p = archive->buffer;
+    const uint8_t *end = archive->buffer + block_header.size;
+    trace_record_t previous;
+    memset(&previous, 0, sizeof(previous));
+    for (uint32_t i = 0; i < block_header.num_records; ++i) {
+        trace_record_t *record = &records[i];
+        uint64_t fields[7];
+        for (size_t j = 0; j < sizeof(fields) / sizeof(*fields); ++j) {
+            if ((p = varint_decode(p, end, &fields[j])) == NULL) {
+                errno = EINVAL;
+                return -1;
+            }
+        }
+
+        if (end - p < 2) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        memset(record, 0, sizeof(*record));
+        record->sequence = previous.sequence + zigzag_decode(fields[0]);
+        record->time = previous.time + zigzag_decode(fields[1]);
+        record->payload = previous.payload + zigzag_decode(fields[2]);
+        record->port = previous.port + zigzag_decode(fields[3]);
+        record->value = fields[4];
+        record->count = fields[5];
+        record->latency = fields[6];
+        record->function = *p++;
+        record->width = *p++;
+        previous = *record;
+    }
+
+    return block_header.num_records;
+}
+
+archive_writer_t *
+archive_writer_create(int fd, const trace_header_t *restrict header, size_t block_records)
+{
+    if (block_records == 0 || block_records > MAX_BLOCK_RECORDS) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    archive_writer_t *writer = (archive_writer_t *)calloc(1, sizeof(*writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+
+    writer->buffer = (uint8_t *)malloc(block_records * MAX_ENCODED_RECORD);
+    if (writer->buffer == NULL) {
+        free(writer);
+        return NULL;
+    }
+
+    writer->fd = fd;
+    memcpy(writer->header.magic, ARCHIVE_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = ARCHIVE_VERSION;
+    writer->header.block_records = block_records;
+    writer->header.trace = *header;
+    if (pwrite_all(fd, &writer->header, sizeof(writer->header), 0) == -1) {
+        archive_writer_destroy(writer);
+        return NULL;
+    }
+
+    writer->offset = sizeof(writer->header);
+    return writer;
+}
+
+void
+archive_writer_destroy(archive_writer_t *restrict writer)
+{
+    if (writer == NULL) {
+        return;
+    }
+
+    free(writer->buffer);
+    free(writer->index);
+    free(writer);
+}
+
+static int
+archive_writer_flush(archive_writer_t *restrict writer)
+{
+    if (writer->block.num_records == 0) {
+        return 0;
+    }
+
+    if (pwrite_all(writer->fd, &writer->block, sizeof(writer->block), writer->offset) == -1
+            || pwrite_all(writer->fd, writer->buffer, writer->block.size, writer->offset + sizeof(writer->block))
+                    == -1
+            || archive_index_append(&writer->index, &writer->num_blocks, writer->offset, &writer->block) == -1) {
+        return -1;
+    }
+
+    writer->offset += sizeof(writer->block) + writer->block.size;
+    memset(&writer->block, 0, sizeof(writer->block));
+    memset(&writer->previous, 0, sizeof(writer->previous));
+    return 0;
+}
+
+int
+archive_writer_finish(archive_writer_t *restrict writer)
+{
+    if (archive_writer_flush(writer) == -1
+            || pwrite_all(writer->fd, writer->index, writer->num_blocks * sizeof(*writer->index), writer->offset)
+                    == -1) {
+        return -1;
+    }
+
+    writer->header.index_offset = writer->offset;
+    writer->header.num_blocks = writer->num_blocks;
+    return pwrite_all(writer->fd, &writer->header, sizeof(writer->header), 0);
+}
+
+int
+archive_writer_write(archive_writer_t *restrict writer, const trace_record_t *restrict record)
+{
+    if (writer->block.num_records == 0) {
+        writer->block.sequence = record->sequence;
+        writer->block.time = record->time;
+        writer->block.position = writer->position;
+        writer->block.digest = writer->digest;
+    }
+
+    writer->position += archive_digest(&writer->header.trace, record, &writer->digest);
+
+    const trace_record_t *previous = &writer->previous;
+    uint8_t *p = writer->buffer + writer->block.size;
+    p = varint_encode(p, zigzag_encode(record->sequence - previous->sequence));
+    p = varint_encode(p, zigzag_encode(record->time - previous->time));
+    p = varint_encode(p, zigzag_encode(record->payload - previous->payload));
+    p = varint_encode(p, zigzag_encode((int32_t)record->port - previous->port));
+    p = varint_encode(p, record->value);
+    p = varint_encode(p, record->count);
+    p = varint_encode(p, record->latency);
+    *p++ = record->function;
+    *p++ = record->width;
+    writer->block.size = p - writer->buffer;
+    writer->previous = *record;
+    if (++writer->block.num_records == writer->header.block_records) {
+        return archive_writer_flush(writer);
+    }
+
+    return 0;
+}
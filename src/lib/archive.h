@@ -0,0 +1,201 @@
+/** @file */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#define ARCHIVE_MAGIC "IOFZARC"
+#define ARCHIVE_VERSION 2
+
+#define ARCHIVE_BLOCK_RECORDS 4096 /**< Default number of records of each block. */
+
+/**
+ * Archive file header.
+ *
+ * The header is followed by the blocks and then by the index, which has an
+ * entry for each block. The index offset is 0 until the archive is finished,
+ * in which case the index is rebuilt from the block headers.
+ */
+typedef struct _archive_header {
+    char magic[8];          /**< ARCHIVE_MAGIC. */
+    uint32_t version;       /**< ARCHIVE_VERSION. */
+    uint32_t block_records; /**< Maximum number of records of each block. */
+    trace_header_t trace;   /**< Trace file header of the records. */
+    uint64_t index_offset;  /**< Offset of the index, in bytes (0 if not finished). */
+    uint64_t num_blocks;    /**< Number of blocks. */
+} archive_header_t;
+
+/**
+ * Archive block header, followed by its records.
+ *
+ * Each record is encoded independently of the other blocks as the
+ * differences, zigzag-encoded, of its sequence number, time, payload and port
+ * from those of the previous record of the block, followed by its value,
+ * count and latency, as variable-length integers of 7 bits per byte, and its
+ * function and width.
+ */
+typedef struct _archive_block {
+    uint32_t size;        /**< Size of the encoded records, in bytes. */
+    uint32_t num_records; /**< Number of records. */
+    uint64_t sequence;    /**< Sequence number of the first record. */
+    uint64_t time;        /**< Time of the first record. */
+    uint64_t position;    /**< Number of operation and response records before the block. */
+    uint64_t digest;      /**< Digest of the operation and response records before the block. */
+} archive_block_t;
+
+/** Archive index entry. */
+typedef struct _archive_index {
+    uint64_t offset;      /**< Offset of the block, in bytes. */
+    uint64_t sequence;    /**< Sequence number of the first record of the block. */
+    uint64_t time;        /**< Time of the first record of the block. */
+    uint64_t position;    /**< Number of operation and response records before the block. */
+    uint64_t digest;      /**< Digest of the operation and response records before the block. */
+    uint32_t num_records; /**< Number of records of the block. */
+    uint32_t reserved;    /**< Reserved. */
+} archive_index_t;
+
+typedef struct _archive archive_t;               /**< Archive reader. */
+typedef struct _archive_writer archive_writer_t; /**< Archive writer. */
+
+/**
+ * Closes the archive.
+ *
+ * @param [in] archive Archive.
+ */
+void archive_close(archive_t *restrict archive);
+
+/**
+ * Chains a record into the digest of the operation and response records of a
+ * trace (i.e., the records two runs are compared by), skipping the other
+ * records. The digest covers the function, port, value, and count of each
+ * record, and the payload of string writes and responses if the payloads are
+ * blob store hashes, but not its sequence number, time, or latency. (The digest
+ * of no records is 0.)
+ *
+ * @param [in] header Trace file header of the record.
+ * @param [in] record Trace record.
+ * @param [in,out] digest Digest of the previous records.
+ * @return 1 if the record was chained into the digest, or 0 if it was skipped.
+ */
+int archive_digest(const trace_header_t *restrict header, const trace_record_t *restrict record, uint64_t *digest);
+
+/**
+ * Finds the block that has the operation or response record at the position
+ * (i.e., the last block that does not start after it).
+ *
+ * @param [in] archive Archive.
+ * @param [in] position Number of operation and response records before the
+ *   record.
+ * @return Block number.
+ */
+size_t archive_find_position(const archive_t *restrict archive, uint64_t position);
+
+/**
+ * Finds the first block that may have records with the sequence number or
+ * later ones (i.e., the last block whose first record is not after it).
+ *
+ * @param [in] archive Archive.
+ * @param [in] sequence Sequence number.
+ * @return Block number.
+ */
+size_t archive_find_sequence(const archive_t *restrict archive, uint64_t sequence);
+
+/**
+ * Finds the first block that may have records with the time or later ones
+ * (i.e., the last block whose first record is not after it).
+ *
+ * @param [in] archive Archive.
+ * @param [in] time Time.
+ * @return Block number.
+ */
+size_t archive_find_time(const archive_t *restrict archive, uint64_t time);
+
+/**
+ * Gets the header of the archive.
+ *
+ * @param [in] archive Archive.
+ * @return Archive file header.
+ */
+const archive_header_t *archive_get_header(const archive_t *restrict archive);
+
+/**
+ * Gets the index of the archive.
+ *
+ * @param [in] archive Archive.
+ * @param [out] num_blocks Number of blocks.
+ * @return Index, with an entry for each block.
+ */
+const archive_index_t *archive_get_index(const archive_t *restrict archive, size_t *num_blocks);
+
+/**
+ * Opens an archive, reading its index (or rebuilding it from the block
+ * headers if the archive was not finished or was truncated).
+ *
+ * @param [in] fd File descriptor, opened for reading.
+ * @return An archive, or NULL and errno is set to indicate the error.
+ */
+archive_t *archive_open(int fd);
+
+/**
+ * Reads and decodes a block of the archive.
+ *
+ * @param [in] archive Archive.
+ * @param [in] block Block number.
+ * @param [out] records Records, at least the maximum number of records of each
+ *   block.
+ * @return Number of records on success; otherwise, -1 and errno is set to
+ *   indicate the error.
+ */
+ssize_t archive_read_block(archive_t *restrict archive, size_t block, trace_record_t *restrict records);
+
+/**
+ * Creates an archive writer for the file descriptor. (The file must be empty.)
+ *
+ * @param [in] fd File descriptor, opened for writing.
+ * @param [in] header Trace file header of the records.
+ * @param [in] block_records Maximum number of records of each block.
+ * @return An archive writer, or NULL and errno is set to indicate the error.
+ */
+archive_writer_t *archive_writer_create(int fd, const trace_header_t *restrict header, size_t block_records);
+
+/**
+ * Destroys the archive writer without finishing the archive. (The file
+ * descriptor is not closed.)
+ *
+ * @param [in] writer Archive writer.
+ */
+void archive_writer_destroy(archive_writer_t *restrict writer);
+
+/**
+ * Writes the last block and the index of the archive, and updates its header.
+ *
+ * @param [in] writer Archive writer.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int archive_writer_finish(archive_writer_t *restrict writer);
+
+/**
+ * Appends a record to the current block of the archive, writing the block if
+ * full.
+ *
+ * @param [in] writer Archive writer.
+ * @param [in] record Trace record.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int archive_writer_write(archive_writer_t *restrict writer, const trace_record_t *restrict record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARCHIVE_H */
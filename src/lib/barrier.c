@@ -0,0 +1,48 @@
+/** @file */
+
+#include "barrier.h"
+
+#include "tsc.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void
+barrier_cancel(barrier_t *restrict barrier)
+{
+    atomic_store_explicit(&barrier->cancelled, 1, memory_order_relaxed);
+}
+
+void
+barrier_init(barrier_t *restrict barrier, size_t num_threads, uint64_t margin)
+{
+    atomic_init(&barrier->count, 0);
+    atomic_init(&barrier->generation, 0);
+    atomic_init(&barrier->cancelled, 0);
+    atomic_init(&barrier->release, 0);
+    barrier->num_threads = num_threads;
+    barrier->margin = margin;
+}
+
+int
+barrier_wait(barrier_t *restrict barrier, uint64_t *release)
+{
+    unsigned int generation = atomic_load_explicit(&barrier->generation, memory_order_acquire);
+    if (atomic_fetch_add_explicit(&barrier->count, 1, memory_order_acq_rel) + 1 == barrier->num_threads) {
+        atomic_store_explicit(&barrier->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&barrier->release, tsc_read() + barrier->margin, memory_order_relaxed);
+        atomic_store_explicit(&barrier->generation, generation + 1, memory_order_release);
+    } else {
+        while (atomic_load_explicit(&barrier->generation, memory_order_acquire) == generation) {
+            if (atomic_load_explicit(&barrier->cancelled, memory_order_relaxed)) {
+                return -1;
+            }
+
+            asm volatile("pause");
+        }
+    }
+
+    *release = atomic_load_explicit(&barrier->release, memory_order_relaxed);
+    return 0;
+}
@@ -0,0 +1,56 @@
+/** @file */
+
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Spin barrier that releases all threads at a common time-stamp counter value. */
+typedef struct _barrier {
+    _Alignas(64) atomic_size_t count;
+    atomic_uint generation;
+    atomic_int cancelled;
+    _Atomic uint64_t release;
+    size_t num_threads;
+    uint64_t margin;
+} barrier_t;
+
+/**
+ * Cancels the barrier, releasing all threads waiting on it.
+ *
+ * @param [in] barrier Barrier.
+ */
+void barrier_cancel(barrier_t *restrict barrier);
+
+/**
+ * Initializes the barrier.
+ *
+ * @param [in] barrier Barrier.
+ * @param [in] num_threads Number of threads.
+ * @param [in] margin Number of time-stamp counter cycles between the arrival
+ *   of the last thread and the release time, which must be long enough for all
+ *   threads to observe the release.
+ */
+void barrier_init(barrier_t *restrict barrier, size_t num_threads, uint64_t margin);
+
+/**
+ * Waits, spinning, for all threads to arrive at the barrier.
+ *
+ * @param [in] barrier Barrier.
+ * @param [out] release Value of the time-stamp counter at which all threads
+ *   are released.
+ * @return 0 on success; otherwise, -1 if the barrier was cancelled.
+ */
+int barrier_wait(barrier_t *restrict barrier, uint64_t *release);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BARRIER_H */
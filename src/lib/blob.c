@@ -0,0 +1,555 @@
+/** @file */
+
+#include "blob.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define ALIGN8(size) (((size) + 7) & ~(uint64_t)7)
+#define BUFFER_SIZE (1 << 20)
+#define INITIAL_SLOTS 64
+#define NUM_SHARDS 16
+#define SHARD(hash) ((hash) >> 60)
+
+#define PRIME64_1 0x9e3779b185ebca87ULL
+#define PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3 0x165667b19e3779f9ULL
+#define PRIME64_4 0x85ebca77c2b2ae63ULL
+#define PRIME64_5 0x27d4eb2f165667c5ULL
+
+/*
+ * Slot of the index. The slot is empty if it has neither an offset nor an
+ * owner; a blob that is only in the buffer of its owner has no offset yet.
+ */
+typedef struct _blob_slot {
+    uint64_t hash;
+    off_t offset;
+    uint64_t size;
+    const blob_buffer_t *owner;
+} blob_slot_t;
+
+/* Shard of the index, selected by the high bits of the hash. */
+typedef struct __attribute__((aligned(64))) _blob_shard {
+    pthread_mutex_t mutex;
+    blob_slot_t *slots;
+    size_t num_slots;
+    size_t num_entries;
+    uint64_t num_blobs;
+    uint64_t num_bytes;
+    uint64_t num_duplicates;
+} blob_shard_t;
+
+struct _blob_store {
+    blob_shard_t shards[NUM_SHARDS];
+    int fd;
+    pthread_mutex_t mutex; /* Serializes the appends, so that the file only grows by complete entries. */
+    off_t size;
+    uint64_t num_appends;
+    uint64_t num_synced;
+};
+
+struct _blob_buffer {
+    blob_store_t *blob_store;
+    pthread_mutex_t mutex;
+    uint8_t *data;
+    size_t size;
+};
+
+static inline uint64_t
+rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+read64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t
+read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t
+round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t
+merge64(uint64_t acc, uint64_t value)
+{
+    acc ^= round64(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t
+blob_hash(const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + size;
+    uint64_t hash = 0;
+    if (size >= 32) {
+        uint64_t v1 = PRIME64_1 + PRIME64_2;
+        uint64_t v2 = PRIME64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = -PRIME64_1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+        }
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = merge64(hash, v1);
+        hash = merge64(hash, v2);
+        hash = merge64(hash, v3);
+        hash = merge64(hash, v4);
+    } else {
+        hash = PRIME64_5;
+    }
+
+    hash += size;
+    for (; p + 8 <= end; p += 8) {
+        hash ^= round64(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (p + 4 <= end) {
+        hash ^= (uint64_t)read32(p) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    for (; p < end; ++p) {
+        hash ^= *p * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static blob_slot_t *
+blob_store_lookup(blob_slot_t *slots, size_t num_slots, uint64_t hash)
+{
+    for (size_t i = hash & (num_slots - 1);; i = (i + 1) & (num_slots - 1)) {
+        if ((slots[i].offset == 0 && slots[i].owner == NULL) || slots[i].hash == hash) {
+            return &slots[i];
+        }
+    }
+}
+
+static blob_slot_t *
+blob_store_insert(blob_shard_t *restrict shard, uint64_t hash, off_t offset, uint64_t size, const blob_buffer_t *owner)
+{
+    if ((shard->num_entries + 1) * 2 > shard->num_slots) {
+        size_t num_slots = shard->num_slots * 2;
+        blob_slot_t *slots = (blob_slot_t *)calloc(num_slots, sizeof(*slots));
+        if (slots == NULL) {
+            return NULL;
+        }
+
+        for (size_t i = 0; i < shard->num_slots; ++i) {
+            if (shard->slots[i].offset != 0 || shard->slots[i].owner != NULL) {
+                *blob_store_lookup(slots, num_slots, shard->slots[i].hash) = shard->slots[i];
+            }
+        }
+
+        free(shard->slots);
+        shard->slots = slots;
+        shard->num_slots = num_slots;
+    }
+
+    blob_slot_t *slot = blob_store_lookup(shard->slots, shard->num_slots, hash);
+    slot->hash = hash;
+    slot->offset = offset;
+    slot->size = size;
+    slot->owner = owner;
+    ++shard->num_entries;
+    return slot;
+}
+
+static int
+blob_store_index(blob_store_t *restrict blob_store)
+{
+    blob_header_t header;
+    if (pread(blob_store->fd, &header, sizeof(header), 0) != sizeof(header) ||
+            memcmp(header.magic, BLOB_MAGIC, sizeof(header.magic)) != 0 || header.version != BLOB_VERSION) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    off_t offset = sizeof(header);
+    blob_entry_t entry;
+    while (offset < blob_store->size) {
+        if (pread(blob_store->fd, &entry, sizeof(entry), offset) != sizeof(entry) ||
+                entry.size > (uint64_t)(blob_store->size - offset - sizeof(entry))) {
+            /* Truncated entry of an interrupted run; it is overwritten. */
+            break;
+        }
+
+        blob_shard_t *shard = &blob_store->shards[SHARD(entry.hash)];
+        blob_slot_t *slot = blob_store_lookup(shard->slots, shard->num_slots, entry.hash);
+        if (slot->offset == 0 && blob_store_insert(shard, entry.hash, offset, entry.size, NULL) == NULL) {
+            return -1;
+        }
+
+        offset += sizeof(entry) + ALIGN8(entry.size);
+    }
+
+    if (offset < blob_store->size && ftruncate(blob_store->fd, offset) == -1) {
+        return -1;
+    }
+
+    blob_store->size = offset;
+    return 0;
+}
+
+/* Appends complete entries to the file. */
+static int
+blob_store_append(blob_store_t *restrict blob_store, const struct iovec *iov, int iovcnt, size_t length, off_t *offset)
+{
+    pthread_mutex_lock(&blob_store->mutex);
+    *offset = blob_store->size;
+    ssize_t result = pwritev(blob_store->fd, iov, iovcnt, blob_store->size);
+    if (result == (ssize_t)length) {
+        blob_store->size += length;
+        ++blob_store->num_appends;
+    } else if (result != -1) {
+        errno = EIO;
+    }
+
+    pthread_mutex_unlock(&blob_store->mutex);
+    return (result == (ssize_t)length) ? 0 : -1;
+}
+
+/* Sets the offset of a blob that was only in a buffer (or not in the store) once it is written. */
+static int
+blob_store_resolve(blob_store_t *restrict blob_store, uint64_t hash, off_t offset, uint64_t size)
+{
+    blob_shard_t *shard = &blob_store->shards[SHARD(hash)];
+    int result = 0;
+    pthread_mutex_lock(&shard->mutex);
+    blob_slot_t *slot = blob_store_lookup(shard->slots, shard->num_slots, hash);
+    if (slot->offset == 0 && slot->owner == NULL) {
+        result = (blob_store_insert(shard, hash, offset, size, NULL) != NULL) ? 0 : -1;
+    } else if (slot->offset == 0) {
+        slot->offset = offset;
+        slot->owner = NULL;
+    }
+
+    pthread_mutex_unlock(&shard->mutex);
+    return result;
+}
+
+int
+blob_buffer_flush(blob_buffer_t *restrict buffer)
+{
+    pthread_mutex_lock(&buffer->mutex);
+    if (buffer->size == 0) {
+        pthread_mutex_unlock(&buffer->mutex);
+        return 0;
+    }
+
+    struct iovec iov = {.iov_base = buffer->data, .iov_len = buffer->size};
+    off_t offset = 0;
+    int result = blob_store_append(buffer->blob_store, &iov, 1, buffer->size, &offset);
+    for (size_t i = 0; i < buffer->size && result == 0;) {
+        blob_entry_t entry;
+        memcpy(&entry, buffer->data + i, sizeof(entry));
+        result = blob_store_resolve(buffer->blob_store, entry.hash, offset + i, entry.size);
+        i += sizeof(entry) + ALIGN8(entry.size);
+    }
+
+    buffer->size = 0;
+    pthread_mutex_unlock(&buffer->mutex);
+    return result;
+}
+
+blob_buffer_t *
+blob_buffer_create(blob_store_t *restrict blob_store)
+{
+    blob_buffer_t *buffer = (blob_buffer_t *)calloc(1, sizeof(*buffer));
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    buffer->data = (uint8_t *)malloc(BUFFER_SIZE);
+    if (buffer->data == NULL) {
+        free(buffer);
+        return NULL;
+    }
+
+    buffer->blob_store = blob_store;
+    pthread_mutex_init(&buffer->mutex, NULL);
+    return buffer;
+}
+
+void
+blob_buffer_destroy(blob_buffer_t *restrict buffer)
+{
+    if (buffer == NULL) {
+        return;
+    }
+
+    blob_buffer_flush(buffer);
+    pthread_mutex_destroy(&buffer->mutex);
+    free(buffer->data);
+    free(buffer);
+}
+
+int
+blob_buffer_put(blob_buffer_t *restrict buffer, const void *data, size_t size, uint64_t *hash)
+{
+    *hash = blob_hash(data, size);
+    blob_shard_t *shard = &buffer->blob_store->shards[SHARD(*hash)];
+    pthread_mutex_lock(&shard->mutex);
+    blob_slot_t *slot = blob_store_lookup(shard->slots, shard->num_slots, *hash);
+    if (slot->offset != 0 || slot->owner == buffer) {
+        ++shard->num_duplicates;
+        pthread_mutex_unlock(&shard->mutex);
+        return 0;
+    }
+
+    /*
+     * A blob only in the buffer of another worker is stored again, so that it
+     * is written when the records of this worker are committed.
+     */
+    if (slot->owner == NULL && blob_store_insert(shard, *hash, 0, size, buffer) == NULL) {
+        pthread_mutex_unlock(&shard->mutex);
+        return -1;
+    }
+
+    ++shard->num_blobs;
+    shard->num_bytes += size;
+    pthread_mutex_unlock(&shard->mutex);
+
+    blob_entry_t entry = {.hash = *hash, .size = size};
+    size_t length = sizeof(entry) + ALIGN8(size);
+    if (length > BUFFER_SIZE) {
+        static const uint8_t padding[8];
+        struct iovec iov[3] = {
+            {.iov_base = &entry,          .iov_len = sizeof(entry)       },
+            {.iov_base = (void *)data,    .iov_len = size                },
+            {.iov_base = (void *)padding, .iov_len = ALIGN8(size) - size },
+        };
+        off_t offset = 0;
+        if (blob_store_append(buffer->blob_store, iov, 3, length, &offset) == -1) {
+            return -1;
+        }
+
+        return blob_store_resolve(buffer->blob_store, *hash, offset, size);
+    }
+
+    pthread_mutex_lock(&buffer->mutex);
+    if (buffer->size + length > BUFFER_SIZE) {
+        pthread_mutex_unlock(&buffer->mutex);
+        if (blob_buffer_flush(buffer) == -1) {
+            return -1;
+        }
+
+        pthread_mutex_lock(&buffer->mutex);
+    }
+
+    uint8_t *p = buffer->data + buffer->size;
+    memcpy(p, &entry, sizeof(entry));
+    memcpy(p + sizeof(entry), data, size);
+    memset(p + sizeof(entry) + size, 0, ALIGN8(size) - size);
+    buffer->size += length;
+    pthread_mutex_unlock(&buffer->mutex);
+    return 0;
+}
+
+blob_store_t *
+blob_store_create(int fd)
+{
+    blob_store_t *blob_store = (blob_store_t *)aligned_alloc(_Alignof(blob_store_t), sizeof(*blob_store));
+    if (blob_store == NULL) {
+        return NULL;
+    }
+
+    memset(blob_store, 0, sizeof(*blob_store));
+    blob_store->fd = fd;
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        blob_shard_t *shard = &blob_store->shards[i];
+        shard->num_slots = INITIAL_SLOTS;
+        shard->slots = (blob_slot_t *)calloc(shard->num_slots, sizeof(*shard->slots));
+        if (shard->slots == NULL) {
+            goto err;
+        }
+    }
+
+    blob_store->size = lseek(fd, 0, SEEK_END);
+    if (blob_store->size == -1) {
+        goto err;
+    }
+
+    if (blob_store->size == 0) {
+        blob_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BLOB_MAGIC, sizeof(header.magic));
+        header.version = BLOB_VERSION;
+        if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            goto err;
+        }
+
+        blob_store->size = sizeof(header);
+        ++blob_store->num_appends;
+    } else if (blob_store_index(blob_store) == -1) {
+        goto err;
+    }
+
+    pthread_mutex_init(&blob_store->mutex, NULL);
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        pthread_mutex_init(&blob_store->shards[i].mutex, NULL);
+    }
+
+    return blob_store;
+
+err:
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        free(blob_store->shards[i].slots);
+    }
+
+    free(blob_store);
+    return NULL;
+}
+
+void
+blob_store_destroy(blob_store_t *restrict blob_store)
+{
+    if (blob_store == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        pthread_mutex_destroy(&blob_store->shards[i].mutex);
+        free(blob_store->shards[i].slots);
+    }
+
+    pthread_mutex_destroy(&blob_store->mutex);
+    free(blob_store);
+}
+
+ssize_t
+blob_store_get(blob_store_t *restrict blob_store, uint64_t hash, void *buf, size_t size)
+{
+    blob_shard_t *shard = &blob_store->shards[SHARD(hash)];
+    pthread_mutex_lock(&shard->mutex);
+    blob_slot_t slot = *blob_store_lookup(shard->slots, shard->num_slots, hash);
+    pthread_mutex_unlock(&shard->mutex);
+    if (slot.offset == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (slot.size > size) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    if (pread(blob_store->fd, buf, slot.size, slot.offset + sizeof(blob_entry_t)) != (ssize_t)slot.size) {
+        if (errno == 0) {
+            errno = EIO;
+        }
+
+        return -1;
+    }
+
+    return slot.size;
+}
+
+void
+blob_store_get_stats(
+        blob_store_t *restrict blob_store, uint64_t *num_blobs, uint64_t *num_bytes, uint64_t *num_duplicates)
+{
+    *num_blobs = 0;
+    *num_bytes = 0;
+    *num_duplicates = 0;
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        blob_shard_t *shard = &blob_store->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        *num_blobs += shard->num_blobs;
+        *num_bytes += shard->num_bytes;
+        *num_duplicates += shard->num_duplicates;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+int
+blob_store_put(blob_store_t *restrict blob_store, const void *data, size_t size, uint64_t *hash)
+{
+    *hash = blob_hash(data, size);
+    blob_shard_t *shard = &blob_store->shards[SHARD(*hash)];
+    pthread_mutex_lock(&shard->mutex);
+    if (blob_store_lookup(shard->slots, shard->num_slots, *hash)->offset != 0) {
+        ++shard->num_duplicates;
+        pthread_mutex_unlock(&shard->mutex);
+        return 0;
+    }
+
+    ++shard->num_blobs;
+    shard->num_bytes += size;
+    pthread_mutex_unlock(&shard->mutex);
+
+    static const uint8_t padding[8];
+    blob_entry_t entry = {.hash = *hash, .size = size};
+    struct iovec iov[3] = {
+        {.iov_base = &entry,          .iov_len = sizeof(entry)       },
+        {.iov_base = (void *)data,    .iov_len = size                },
+        {.iov_base = (void *)padding, .iov_len = ALIGN8(size) - size },
+    };
+    off_t offset = 0;
+    if (blob_store_append(blob_store, iov, 3, sizeof(entry) + ALIGN8(size), &offset) == -1) {
+        return -1;
+    }
+
+    return blob_store_resolve(blob_store, *hash, offset, size);
+}
+
+int
+blob_store_sync(blob_store_t *restrict blob_store)
+{
+    pthread_mutex_lock(&blob_store->mutex);
+    uint64_t num_appends = blob_store->num_appends;
+    int synced = (num_appends == blob_store->num_synced);
+    pthread_mutex_unlock(&blob_store->mutex);
+    if (synced) {
+        return 0;
+    }
+
+    if (fdatasync(blob_store->fd) == -1 && errno != EINVAL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&blob_store->mutex);
+    if (num_appends > blob_store->num_synced) {
+        blob_store->num_synced = num_appends;
+    }
+
+    pthread_mutex_unlock(&blob_store->mutex);
+    return 0;
+}
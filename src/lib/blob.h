@@ -0,0 +1,158 @@
+/** @file */
+
+#ifndef BLOB_H
+#define BLOB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#define BLOB_MAGIC "IOFZBLB"
+#define BLOB_VERSION 1
+
+/** Blob store file header. */
+typedef struct _blob_header {
+    char magic[8];     /**< BLOB_MAGIC. */
+    uint32_t version;  /**< BLOB_VERSION. */
+    uint32_t reserved; /**< Reserved. */
+} blob_header_t;
+
+/** Blob store entry header, followed by the data padded to 8 bytes. */
+typedef struct _blob_entry {
+    uint64_t hash; /**< Hash of the data. */
+    uint64_t size; /**< Size of the data, in bytes. */
+} blob_entry_t;
+
+/** Deduplicated, append-only store of blobs keyed by the hash of their data. */
+typedef struct _blob_store blob_store_t;
+
+/**
+ * Append buffer of a single thread, whose blobs are written to the store in
+ * one write when it is flushed (e.g., before the records that refer to them
+ * are committed) or full.
+ */
+typedef struct _blob_buffer blob_buffer_t;
+
+/**
+ * Writes the blobs of the buffer to the store.
+ *
+ * @param [in] buffer Append buffer.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int blob_buffer_flush(blob_buffer_t *restrict buffer);
+
+/**
+ * Creates an append buffer for the blob store.
+ *
+ * @param [in] blob_store Blob store.
+ * @return An append buffer, or NULL and errno is set to indicate the error.
+ */
+blob_buffer_t *blob_buffer_create(blob_store_t *restrict blob_store);
+
+/**
+ * Destroys the append buffer, writing its blobs to the store.
+ *
+ * @param [in] buffer Append buffer.
+ */
+void blob_buffer_destroy(blob_buffer_t *restrict buffer);
+
+/**
+ * Stores the blob through the append buffer, unless it is already in the store
+ * or in the buffer. (A blob only in the buffer of another thread is stored
+ * again, so that flushing this buffer is enough for the blobs of this thread to
+ * be written. Blobs larger than the buffer are written directly.)
+ *
+ * @param [in] buffer Append buffer.
+ * @param [in] data Data.
+ * @param [in] size Size of the data, in bytes.
+ * @param [out] hash Hash of the data.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int blob_buffer_put(blob_buffer_t *restrict buffer, const void *data, size_t size, uint64_t *hash);
+
+/**
+ * Computes the 64-bit hash of the data. (XXH64, which processes the data in
+ * four independent lanes of 8 bytes.)
+ *
+ * @param [in] data Data.
+ * @param [in] size Size of the data, in bytes.
+ * @return Hash of the data.
+ */
+uint64_t blob_hash(const void *data, size_t size);
+
+/**
+ * Creates a blob store for the file descriptor. The header is written if the
+ * file is empty; otherwise, it is checked and the existing entries are
+ * indexed.
+ *
+ * @param [in] fd File descriptor, opened for reading and appending.
+ * @return A blob store, or NULL and errno is set to indicate the error.
+ */
+blob_store_t *blob_store_create(int fd);
+
+/**
+ * Destroys the blob store. (The file descriptor is not closed.)
+ *
+ * @param [in] blob_store Blob store.
+ */
+void blob_store_destroy(blob_store_t *restrict blob_store);
+
+/**
+ * Reads the data of the blob.
+ *
+ * @param [in] blob_store Blob store.
+ * @param [in] hash Hash of the data.
+ * @param [out] buf Buffer.
+ * @param [in] size Size of the buffer, in bytes.
+ * @return Size of the data, in bytes, or -1 and errno is set to indicate the
+ *   error (ENOENT if the blob is not in the store, or ENOBUFS if the buffer is
+ *   too small).
+ */
+ssize_t blob_store_get(blob_store_t *restrict blob_store, uint64_t hash, void *buf, size_t size);
+
+/**
+ * Gets the statistics of the blob store.
+ *
+ * @param [in] blob_store Blob store.
+ * @param [out] num_blobs Number of blobs stored since the store was created.
+ * @param [out] num_bytes Number of bytes of data stored since the store was
+ *   created.
+ * @param [out] num_duplicates Number of blobs not stored because they were
+ *   already in the store.
+ */
+void blob_store_get_stats(
+        blob_store_t *restrict blob_store, uint64_t *num_blobs, uint64_t *num_bytes, uint64_t *num_duplicates);
+
+/**
+ * Stores the blob, unless it is already in the store, writing it directly.
+ * (Thread-safe. The index is sharded by hash, and only the writes to the file
+ * are serialized.)
+ *
+ * @param [in] blob_store Blob store.
+ * @param [in] data Data.
+ * @param [in] size Size of the data, in bytes.
+ * @param [out] hash Hash of the data.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int blob_store_put(blob_store_t *restrict blob_store, const void *data, size_t size, uint64_t *hash);
+
+/**
+ * Synchronizes the blob store file with the storage device, if blobs were
+ * written since the last synchronization, so that the records that refer to
+ * them can be committed.
+ *
+ * @param [in] blob_store Blob store.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int blob_store_sync(blob_store_t *restrict blob_store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOB_H */
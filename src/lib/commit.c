@@ -0,0 +1,300 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "commit.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#define PREALLOCATION_SIZE (64 << 20)
+
+struct _committer {
+    pthread_t thread;
+    int started;
+    uint64_t interval;
+    commit_t **commits;
+    size_t num_commits;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stopping;
+};
+
+static uint64_t
+commit_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static int
+commit_preallocate(commit_t *restrict commit)
+{
+#ifdef HAVE_FALLOCATE
+    if (commit->allocated == -1) {
+        return 0;
+    }
+
+    /* The file is not seekable (e.g., a pipe or a terminal). */
+    off_t size = lseek(commit->fd, 0, SEEK_END);
+    if (size == -1) {
+        commit->allocated = -1;
+        return 0;
+    }
+
+    if (size + (PREALLOCATION_SIZE / 2) < commit->allocated) {
+        return 0;
+    }
+
+    if (fallocate(commit->fd, FALLOC_FL_KEEP_SIZE, size, PREALLOCATION_SIZE) == -1) {
+        if (errno != EOPNOTSUPP && errno != ENODEV) {
+            return -1;
+        }
+
+        /* The file system or the file does not support preallocation (e.g., a character device). */
+        commit->allocated = -1;
+        return 0;
+    }
+
+    commit->allocated = size + PREALLOCATION_SIZE;
+#else
+    commit->allocated = -1;
+#endif
+    return 0;
+}
+
+void
+commit_init(commit_t *restrict commit, int fd, int policy, uint64_t interval)
+{
+    commit->fd = fd;
+    commit->policy = policy;
+    commit->interval = interval;
+    commit->pending = 0;
+    commit->last = commit_now();
+    commit->allocated = 0;
+    commit->num_commits = 0;
+    commit->time = 0;
+    commit->flush = NULL;
+    commit->context = NULL;
+    commit->error = 0;
+    pthread_mutex_init(&commit->mutex, NULL);
+    /* Errors are reported by the next commit_sync(), which preallocates the space again. */
+    if (policy != COMMIT_NONE) {
+        commit_preallocate(commit);
+    }
+}
+
+void
+commit_lock(commit_t *restrict commit)
+{
+    if (commit->policy == COMMIT_INTERVAL) {
+        pthread_mutex_lock(&commit->mutex);
+    }
+}
+
+int
+commit_record(commit_t *restrict commit)
+{
+    ++commit->pending;
+    switch (commit->policy) {
+    case COMMIT_EVERY:
+        return commit_sync(commit);
+
+    case COMMIT_RECORDS:
+        return (commit->pending >= commit->interval) ? commit_sync(commit) : 0;
+
+    case COMMIT_INTERVAL:
+        if (commit->error != 0) {
+            errno = commit->error;
+            return -1;
+        }
+
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+void
+commit_set_flush(commit_t *restrict commit, commit_flush_t *flush, void *context)
+{
+    commit->flush = flush;
+    commit->context = context;
+}
+
+int
+commit_sync(commit_t *restrict commit)
+{
+    if (commit->pending == 0) {
+        return 0;
+    }
+
+    uint64_t begin = commit_now();
+    if (commit->flush != NULL) {
+        commit->fd = commit->flush(commit->context);
+        if (commit->fd == -1) {
+            return -1;
+        }
+    }
+
+    if (commit_preallocate(commit) == -1) {
+        return -1;
+    }
+
+    int result = fdatasync(commit->fd);
+    if (result == -1 && errno == EINVAL) {
+        /* The file does not support synchronization (e.g., a pipe or a terminal). */
+        result = 0;
+    }
+
+    commit->last = commit_now();
+    commit->time += commit->last - begin;
+    commit->pending = 0;
+    ++commit->num_commits;
+    return result;
+}
+
+void
+commit_unlock(commit_t *restrict commit)
+{
+    if (commit->policy == COMMIT_INTERVAL) {
+        pthread_mutex_unlock(&commit->mutex);
+    }
+}
+
+int
+committer_add(committer_t *restrict committer, commit_t *commit)
+{
+    if (committer->started) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (commit->policy != COMMIT_INTERVAL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    commit_t **commits = (commit_t **)realloc(committer->commits, (committer->num_commits + 1) * sizeof(*commits));
+    if (commits == NULL) {
+        return -1;
+    }
+
+    committer->commits = commits;
+    committer->commits[committer->num_commits++] = commit;
+    return 0;
+}
+
+committer_t *
+committer_create(uint64_t interval)
+{
+    if (interval == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    committer_t *committer = (committer_t *)calloc(1, sizeof(*committer));
+    if (committer == NULL) {
+        return NULL;
+    }
+
+    committer->interval = interval;
+    pthread_mutex_init(&committer->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&committer->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return committer;
+}
+
+void
+committer_destroy(committer_t *restrict committer)
+{
+    if (committer == NULL) {
+        return;
+    }
+
+    if (committer->started) {
+        pthread_mutex_lock(&committer->mutex);
+        committer->stopping = 1;
+        pthread_cond_signal(&committer->cond);
+        pthread_mutex_unlock(&committer->mutex);
+        pthread_join(committer->thread, NULL);
+    }
+
+    pthread_cond_destroy(&committer->cond);
+    pthread_mutex_destroy(&committer->mutex);
+    free(committer->commits);
+    free(committer);
+}
+
+static void *
+committer_run(void *arg)
+{
+    committer_t *committer = (committer_t *)arg;
+    pthread_mutex_lock(&committer->mutex);
+    while (!committer->stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += committer->interval / 1000000000;
+        deadline.tv_nsec += committer->interval % 1000000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (!committer->stopping && pthread_cond_timedwait(&committer->cond, &committer->mutex, &deadline) == 0) {
+        }
+
+        if (committer->stopping) {
+            break;
+        }
+
+        pthread_mutex_unlock(&committer->mutex);
+        for (size_t i = 0; i < committer->num_commits; ++i) {
+            commit_t *commit = committer->commits[i];
+            pthread_mutex_lock(&commit->mutex);
+            if (commit->pending != 0 && commit_now() - commit->last >= committer->interval
+                    && commit_sync(commit) == -1 && commit->error == 0) {
+                commit->error = errno;
+            }
+
+            pthread_mutex_unlock(&commit->mutex);
+        }
+
+        pthread_mutex_lock(&committer->mutex);
+    }
+
+    pthread_mutex_unlock(&committer->mutex);
+    return NULL;
+}
+
+int
+committer_start(committer_t *restrict committer)
+{
+    if (committer->started) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    int error = pthread_create(&committer->thread, NULL, committer_run, committer);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    committer->started = 1;
+    return 0;
+}
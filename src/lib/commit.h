@@ -0,0 +1,153 @@
+/** @file */
+
+#ifndef COMMIT_H
+#define COMMIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+/** Durability policies of a log file. */
+enum {
+    COMMIT_EVERY,    /**< Synchronize after every record. */
+    COMMIT_RECORDS,  /**< Synchronize after every interval records. */
+    COMMIT_INTERVAL, /**< Synchronize at most once every interval nanoseconds (from a committer thread). */
+    COMMIT_NONE,     /**< Never synchronize. */
+};
+
+/**
+ * Flush handler, called before each synchronization to write the data
+ * buffered for the log file.
+ *
+ * @param [in] context Context passed to the flush handler.
+ * @return File descriptor of the log file to synchronize, or -1 and errno is
+ *   set to indicate the error.
+ */
+typedef int commit_flush_t(void *context);
+
+/** Group commit of the records written to a log file. */
+typedef struct _commit {
+    int fd;                /**< File descriptor of the log file. */
+    int policy;            /**< Durability policy. */
+    uint64_t interval;     /**< Number of records or nanoseconds between synchronizations. */
+    uint64_t pending;      /**< Number of records written since the last synchronization. */
+    uint64_t last;         /**< Time of the last synchronization, in nanoseconds. */
+    off_t allocated;       /**< End of the preallocated space, or -1 if preallocation is not supported. */
+    uint64_t num_commits;  /**< Number of synchronizations. */
+    uint64_t time;         /**< Time spent synchronizing, in nanoseconds. */
+    commit_flush_t *flush; /**< Flush handler, or NULL. */
+    void *context;         /**< Context passed to the flush handler. */
+    pthread_mutex_t mutex; /**< Lock of the log file against the committer thread (COMMIT_INTERVAL only). */
+    int error;             /**< Error of the last synchronization by the committer thread, or 0. */
+} commit_t;
+
+/**
+ * Thread that synchronizes the log files with the COMMIT_INTERVAL policy once
+ * their interval elapses, so that the last records are synchronized even if no
+ * record follows them (e.g., because the guest hung).
+ */
+typedef struct _committer committer_t;
+
+/**
+ * Initializes the group commit and preallocates space for the log file.
+ *
+ * @param [in] commit Group commit.
+ * @param [in] fd File descriptor of the log file.
+ * @param [in] policy Durability policy.
+ * @param [in] interval Number of records (COMMIT_RECORDS) or nanoseconds
+ *   (COMMIT_INTERVAL) between synchronizations.
+ */
+void commit_init(commit_t *restrict commit, int fd, int policy, uint64_t interval);
+
+/**
+ * Locks the log file against the committer thread, before writing a record and
+ * calling commit_record(). (Does nothing unless the durability policy is
+ * COMMIT_INTERVAL.)
+ *
+ * @param [in] commit Group commit.
+ */
+void commit_lock(commit_t *restrict commit);
+
+/**
+ * Accounts for a record written to the log file, and synchronizes the file if
+ * the durability policy requires it. (With the COMMIT_INTERVAL policy, the
+ * file is synchronized by the committer thread instead.)
+ *
+ * @param [in] commit Group commit.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error
+ *   (including an error of the last synchronization by the committer thread).
+ */
+int commit_record(commit_t *restrict commit);
+
+/**
+ * Sets the flush handler of the group commit, for log files whose data is
+ * buffered or whose file descriptor changes (e.g., rotating segments). (Space
+ * is only preallocated if a file descriptor was passed to commit_init().)
+ *
+ * @param [in] commit Group commit.
+ * @param [in] flush Flush handler.
+ * @param [in] context Context passed to the flush handler.
+ */
+void commit_set_flush(commit_t *restrict commit, commit_flush_t *flush, void *context);
+
+/**
+ * Synchronizes the data of the log file with fdatasync(), extending the
+ * preallocated space beforehand if it is running out, so that only the file
+ * size must be written with the data.
+ *
+ * @param [in] commit Group commit.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int commit_sync(commit_t *restrict commit);
+
+/**
+ * Unlocks the log file locked by commit_lock().
+ *
+ * @param [in] commit Group commit.
+ */
+void commit_unlock(commit_t *restrict commit);
+
+/**
+ * Adds a group commit with the COMMIT_INTERVAL policy to the committer.
+ * (Group commits must be added before the committer is started.)
+ *
+ * @param [in] committer Committer.
+ * @param [in] commit Group commit.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int committer_add(committer_t *restrict committer, commit_t *commit);
+
+/**
+ * Creates a committer.
+ *
+ * @param [in] interval Interval between synchronizations, in nanoseconds.
+ * @return A committer, or NULL and errno is set to indicate the error.
+ */
+committer_t *committer_create(uint64_t interval);
+
+/**
+ * Destroys the committer, stopping its thread if it is running. (The pending
+ * records are synchronized by commit_sync() afterwards.)
+ *
+ * @param [in] committer Committer.
+ */
+void committer_destroy(committer_t *restrict committer);
+
+/**
+ * Starts the committer thread.
+ *
+ * @param [in] committer Committer.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int committer_start(committer_t *restrict committer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMIT_H */
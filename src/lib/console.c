@@ -0,0 +1,74 @@
+/** @file */
+
+#include "console.h"
+
+#ifdef IO_DRY_RUN
+#error "IO_DRY_RUN is only for iofuzzer-bench-dry-run"
+#endif
+
+#include "io.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define UART_LSR 5         /* Line status register. */
+#define UART_LSR_THRE 0x20 /* Transmitter holding register empty. */
+#define UART_MAX_POLLS 100000
+
+struct _console {
+    uint16_t port;
+    int type;
+    pthread_mutex_t mutex;
+};
+
+console_t *
+console_create(uint16_t port, int type)
+{
+    if (type != CONSOLE_DEBUGCON && type != CONSOLE_UART) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    console_t *console = (console_t *)malloc(sizeof(*console));
+    if (console == NULL) {
+        return NULL;
+    }
+
+    console->port = port;
+    console->type = type;
+    pthread_mutex_init(&console->mutex, NULL);
+    return console;
+}
+
+void
+console_destroy(console_t *restrict console)
+{
+    if (console == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&console->mutex);
+    free(console);
+}
+
+void
+console_write(console_t *restrict console, const void *buf, size_t size)
+{
+    pthread_mutex_lock(&console->mutex);
+    if (console->type == CONSOLE_DEBUGCON) {
+        io_write_string8(console->port, (const uint8_t *)buf, size);
+    } else {
+        for (size_t i = 0; i < size; ++i) {
+            for (int j = 0; j < UART_MAX_POLLS && (io_read8(console->port + UART_LSR) & UART_LSR_THRE) == 0; ++j) {
+                asm volatile("pause");
+            }
+
+            io_write8(console->port, ((const uint8_t *)buf)[i]);
+        }
+    }
+
+    pthread_mutex_unlock(&console->mutex);
+}
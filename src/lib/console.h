@@ -0,0 +1,57 @@
+/** @file */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONSOLE_UART_NUM_PORTS 8 /**< Number of I/O ports of a 16550 UART. */
+
+/** Types of console ports. */
+enum {
+    CONSOLE_DEBUGCON, /**< Debug console port (e.g., QEMU debugcon at 0xe9). */
+    CONSOLE_UART,     /**< Transmitter holding register of a 16550 UART. */
+};
+
+/** Host-visible console port the records are written to. */
+typedef struct _console console_t;
+
+/**
+ * Creates a console. (The calling process must have I/O privileges.)
+ *
+ * @param [in] port I/O port address of the console (i.e., the debug console
+ *   port or the base address of the UART).
+ * @param [in] type Type of the console port.
+ * @return A console, or NULL and errno is set to indicate the error.
+ */
+console_t *console_create(uint16_t port, int type);
+
+/**
+ * Destroys the console.
+ *
+ * @param [in] console Console.
+ */
+void console_destroy(console_t *restrict console);
+
+/**
+ * Writes the buffer to the console. Writes of concurrent threads are not
+ * interleaved. (A debug console port is written with a single string
+ * instruction; a UART is written a byte at a time when its transmitter
+ * holding register is empty.)
+ *
+ * @param [in] console Console.
+ * @param [in] buf Buffer.
+ * @param [in] size Size of the buffer, in bytes.
+ */
+void console_write(console_t *restrict console, const void *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSOLE_H */
@@ -0,0 +1,132 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cpu.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+cpu_get_available(int **cpus, size_t *num_cpus)
+{
+    if (cpus == NULL || num_cpus == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == -1) {
+        return -1;
+    }
+
+    *num_cpus = CPU_COUNT(&set);
+    *cpus = (int *)calloc(*num_cpus, sizeof(**cpus));
+    if (*cpus == NULL) {
+        return -1;
+    }
+
+    for (int cpu = 0, i = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            (*cpus)[i++] = cpu;
+        }
+    }
+
+    return 0;
+}
+
+static int
+cpu_list_contains(const char *filename, int cpu)
+{
+    FILE *stream = fopen(filename, "r");
+    if (stream == NULL) {
+        return 0;
+    }
+
+    char list[4096];
+    if (fgets(list, sizeof(list), stream) == NULL) {
+        fclose(stream);
+        return 0;
+    }
+
+    fclose(stream);
+    for (char *str = list; *str != '\0' && *str != '\n';) {
+        char *end = NULL;
+        long begin = strtol(str, &end, 10);
+        if (end == str) {
+            return 0;
+        }
+
+        long last = begin;
+        if (*end == '-') {
+            str = end + 1;
+            last = strtol(str, &end, 10);
+            if (end == str) {
+                return 0;
+            }
+        }
+
+        if (cpu >= begin && cpu <= last) {
+            return 1;
+        }
+
+        str = (*end == ',') ? (end + 1) : end;
+    }
+
+    return 0;
+}
+
+int
+cpu_get_isolation(int cpu)
+{
+    int flags = 0;
+    if (cpu_list_contains("/sys/devices/system/cpu/isolated", cpu)) {
+        flags |= CPU_ISOLATED;
+    }
+
+    if (cpu_list_contains("/sys/devices/system/cpu/nohz_full", cpu)) {
+        flags |= CPU_NOHZ_FULL;
+    }
+
+    return flags;
+}
+
+int
+cpu_pin(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+cpu_set_fifo(int priority)
+{
+    struct sched_param param = {.sched_priority = priority};
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/** @file */
+
+#ifndef CPU_H
+#define CPU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#define CPU_ISOLATED 0x1  /**< CPU is isolated from the scheduler (isolcpus). */
+#define CPU_NOHZ_FULL 0x2 /**< CPU is in adaptive-tick mode (nohz_full). */
+
+/**
+ * Gets the list of CPUs the calling process is allowed to run on.
+ *
+ * @param [out] cpus List of CPU numbers. (Must be freed by the caller.)
+ * @param [out] num_cpus Number of CPU numbers.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int cpu_get_available(int **cpus, size_t *num_cpus);
+
+/**
+ * Gets the isolation flags of the CPU from sysfs.
+ *
+ * @param [in] cpu CPU number.
+ * @return Isolation flags of the CPU (i.e., CPU_ISOLATED and CPU_NOHZ_FULL).
+ */
+int cpu_get_isolation(int cpu);
+
+/**
+ * Pins the calling thread to the CPU.
+ *
+ * @param [in] cpu CPU number.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int cpu_pin(int cpu);
+
+/**
+ * Sets the scheduling policy of the calling thread to SCHED_FIFO.
+ *
+ * @param [in] priority Real-time priority.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int cpu_set_fifo(int priority);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_H */
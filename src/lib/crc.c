@@ -0,0 +1,50 @@
+/** @file */
+
+#include "crc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CRC32C_POLY 0x82f63b78
+
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *p, size_t size)
+{
+    uint64_t crc64 = crc;
+    for (; size >= sizeof(uint64_t); p += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        crc64 = __builtin_ia32_crc32di(crc64, value);
+    }
+
+    crc = crc64;
+    for (; size > 0; ++p, --size) {
+        crc = __builtin_ia32_crc32qi(crc, *p);
+    }
+
+    return crc;
+}
+
+static uint32_t
+crc32c_generic(uint32_t crc, const uint8_t *p, size_t size)
+{
+    for (; size > 0; ++p, --size) {
+        crc ^= *p;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+        }
+    }
+
+    return crc;
+}
+
+uint32_t
+crc32c(uint32_t crc, const void *data, size_t size)
+{
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ~crc32c_sse42(~crc, (const uint8_t *)data, size);
+    }
+
+    return ~crc32c_generic(~crc, (const uint8_t *)data, size);
+}
@@ -0,0 +1,28 @@
+/** @file */
+
+#ifndef CRC_H
+#define CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Computes the CRC-32C (Castagnoli) of the data, using the SSE4.2 crc32
+ * instruction if the processor supports it.
+ *
+ * @param [in] crc CRC-32C of the preceding data (0 for the first data).
+ * @param [in] data Data.
+ * @param [in] size Size of the data, in bytes.
+ * @return CRC-32C of the preceding data and the data.
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC_H */
@@ -0,0 +1,153 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "device.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+
+#define IORESOURCE_IO 0x100 /**< Resource flag of I/O port ranges. */
+#define MAX_DEPTH 8         /**< Maximum depth of stacked block devices. */
+
+static int
+is_pci_address(const char *name)
+{
+    unsigned int domain = 0;
+    unsigned int bus = 0;
+    unsigned int slot = 0;
+    unsigned int function = 0;
+    int size = 0;
+    return sscanf(name, "%x:%x:%x.%x%n", &domain, &bus, &slot, &function, &size) == 4 && name[size] == '\0';
+}
+
+static int
+device_read_resources(const char *dirname, const char *pci, device_io_range_t *ranges, size_t max_ranges,
+        size_t *num_ranges)
+{
+    char filename[PATH_MAX];
+    if (snprintf(filename, sizeof(filename), "%s/resource", dirname) >= (int)sizeof(filename)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    FILE *stream = fopen(filename, "r");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    unsigned long long flags = 0;
+    while (fscanf(stream, "%llx %llx %llx", &first, &last, &flags) == 3) {
+        if ((flags & IORESOURCE_IO) == 0 || first > last || last > 0xffff) {
+            continue;
+        }
+
+        size_t i = 0;
+        while (i < *num_ranges && !(ranges[i].first == (int)first && ranges[i].last == (int)last)) {
+            ++i;
+        }
+
+        if (i == *num_ranges && *num_ranges < max_ranges) {
+            device_io_range_t *range = &ranges[(*num_ranges)++];
+            snprintf(range->pci, sizeof(range->pci), "%s", pci);
+            range->first = first;
+            range->last = last;
+        }
+    }
+
+    fclose(stream);
+    return 0;
+}
+
+static int
+device_walk(const char *name, device_io_range_t *ranges, size_t max_ranges, size_t *num_ranges, int depth)
+{
+    char path[PATH_MAX];
+    if (realpath(name, path) == NULL) {
+        return -1;
+    }
+
+    for (char *slash = NULL; (slash = strrchr(path, '/')) != NULL && slash != path; *slash = '\0') {
+        char slaves[PATH_MAX];
+        if (snprintf(slaves, sizeof(slaves), "%s/slaves", path) >= (int)sizeof(slaves)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        DIR *dir = (depth < MAX_DEPTH) ? opendir(slaves) : NULL;
+        if (dir != NULL) {
+            struct dirent *entry = NULL;
+            while ((entry = readdir(dir)) != NULL) {
+                if (entry->d_name[0] == '.') {
+                    continue;
+                }
+
+                char slave[PATH_MAX];
+                if (snprintf(slave, sizeof(slave), "%s/%s", slaves, entry->d_name) >= (int)sizeof(slave)
+                        || device_walk(slave, ranges, max_ranges, num_ranges, depth + 1) == -1) {
+                    closedir(dir);
+                    return -1;
+                }
+            }
+
+            closedir(dir);
+        }
+
+        /* The nearest PCI function is the controller (e.g., not the bridges above it). */
+        if (is_pci_address(slash + 1)) {
+            return device_read_resources(path, slash + 1, ranges, max_ranges, num_ranges);
+        }
+    }
+
+    return 0;
+}
+
+ssize_t
+device_get_io_ranges(const char *path, device_io_range_t *ranges, size_t max_ranges)
+{
+    struct stat st;
+    if (stat(path, &st) == -1) {
+        if (errno != ENOENT) {
+            return -1;
+        }
+
+        char dirname[PATH_MAX];
+        snprintf(dirname, sizeof(dirname), "%s", path);
+        char *slash = strrchr(dirname, '/');
+        if (slash == NULL) {
+            strcpy(dirname, ".");
+        } else {
+            slash[(slash == dirname) ? 1 : 0] = '\0';
+        }
+
+        if (stat(dirname, &st) == -1) {
+            return -1;
+        }
+    }
+
+    if (major(st.st_dev) == 0) {
+        /* File system without a block device (e.g., tmpfs). */
+        return 0;
+    }
+
+    char name[PATH_MAX];
+    snprintf(name, sizeof(name), "/sys/dev/block/%u:%u", major(st.st_dev), minor(st.st_dev));
+    size_t num_ranges = 0;
+    if (device_walk(name, ranges, max_ranges, &num_ranges, 0) == -1) {
+        return (errno == ENOENT) ? (ssize_t)num_ranges : -1;
+    }
+
+    return num_ranges;
+}
@@ -0,0 +1,41 @@
+/** @file */
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/** I/O port range of a PCI function. */
+typedef struct _device_io_range {
+    char pci[32]; /**< PCI address of the function (e.g., 0000:00:01.1). */
+    int first;    /**< First I/O port address. */
+    int last;     /**< Last I/O port address. */
+} device_io_range_t;
+
+/**
+ * Gets the I/O port ranges (i.e., the I/O BARs, including the legacy ranges of
+ * IDE controllers) of the PCI functions backing the file system of the path,
+ * from sysfs. The block device of the file system is followed to its PCI
+ * function (e.g., the virtio-blk, IDE, AHCI, or USB host controller), and
+ * through its slaves for stacked devices (e.g., device mapper and MD). File
+ * systems without a block device (e.g., tmpfs) have no ranges.
+ *
+ * @param [in] path Path of a file or directory (or of a file yet to be created
+ *   in an existing directory).
+ * @param [out] ranges I/O port ranges.
+ * @param [in] max_ranges Maximum number of I/O port ranges.
+ * @return Number of I/O port ranges on success; otherwise, -1 and errno is set
+ *   to indicate the error.
+ */
+ssize_t device_get_io_ranges(const char *path, device_io_range_t *ranges, size_t max_ranges);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEVICE_H */
@@ -0,0 +1,269 @@
+/** @file */
+
+#include "exporter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE (64 * 1024)
+
+typedef struct _exporter_file {
+    int source;
+    int destination;
+    off_t offset;
+} exporter_file_t;
+
+struct _exporter {
+    pthread_t thread;
+    int started;
+    char *directory;
+    unsigned long interval;
+    exporter_file_t *files;
+    size_t num_files;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stopping;
+    int error;
+    _Atomic uint64_t bytes;
+    uint8_t *buffer;
+};
+
+static int
+write_all(int fd, const void *buf, size_t count)
+{
+    const uint8_t *ptr = (const uint8_t *)buf;
+    while (count > 0) {
+        ssize_t result = write(fd, ptr, count);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        ptr += result;
+        count -= result;
+    }
+
+    return 0;
+}
+
+static int
+exporter_export(exporter_t *restrict exporter)
+{
+    for (size_t i = 0; i < exporter->num_files; ++i) {
+        exporter_file_t *file = &exporter->files[i];
+        off_t offset = file->offset;
+        ssize_t size = 0;
+        while ((size = pread(file->source, exporter->buffer, BUFFER_SIZE, file->offset)) > 0) {
+            if (write_all(file->destination, exporter->buffer, size) == -1) {
+                return -1;
+            }
+
+            file->offset += size;
+        }
+
+        if (size == -1) {
+            return -1;
+        }
+
+        if (file->offset != offset) {
+            atomic_fetch_add_explicit(&exporter->bytes, file->offset - offset, memory_order_relaxed);
+            if (fdatasync(file->destination) == -1) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int
+exporter_add_file(exporter_t *restrict exporter, const char *filename)
+{
+    if (exporter->started) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    exporter_file_t *files =
+            (exporter_file_t *)realloc(exporter->files, (exporter->num_files + 1) * sizeof(*files));
+    if (files == NULL) {
+        return -1;
+    }
+
+    exporter->files = files;
+    const char *basename = strrchr(filename, '/');
+    basename = (basename != NULL) ? (basename + 1) : filename;
+    char destination[PATH_MAX];
+    snprintf(destination, sizeof(destination), "%s/%s", exporter->directory, basename);
+    exporter_file_t *file = &exporter->files[exporter->num_files];
+    file->offset = 0;
+    file->source = open(filename, O_RDONLY);
+    if (file->source == -1) {
+        return -1;
+    }
+
+    file->destination = open(destination, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (file->destination == -1) {
+        close(file->source);
+        return -1;
+    }
+
+    ++exporter->num_files;
+    return 0;
+}
+
+exporter_t *
+exporter_create(const char *directory, unsigned long interval)
+{
+    exporter_t *exporter = (exporter_t *)calloc(1, sizeof(*exporter));
+    if (exporter == NULL) {
+        return NULL;
+    }
+
+    exporter->directory = strdup(directory);
+    exporter->buffer = (uint8_t *)malloc(BUFFER_SIZE);
+    if (exporter->directory == NULL || exporter->buffer == NULL) {
+        free(exporter->buffer);
+        free(exporter->directory);
+        free(exporter);
+        return NULL;
+    }
+
+    exporter->interval = interval;
+    pthread_mutex_init(&exporter->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&exporter->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    atomic_init(&exporter->bytes, 0);
+    return exporter;
+}
+
+void
+exporter_destroy(exporter_t *restrict exporter)
+{
+    if (exporter == NULL) {
+        return;
+    }
+
+    if (exporter->started) {
+        exporter_stop(exporter);
+    }
+
+    for (size_t i = 0; i < exporter->num_files; ++i) {
+        close(exporter->files[i].source);
+        close(exporter->files[i].destination);
+    }
+
+    pthread_cond_destroy(&exporter->cond);
+    pthread_mutex_destroy(&exporter->mutex);
+    free(exporter->files);
+    free(exporter->buffer);
+    free(exporter->directory);
+    free(exporter);
+}
+
+uint64_t
+exporter_get_bytes(const exporter_t *restrict exporter)
+{
+    return atomic_load_explicit(&((exporter_t *)exporter)->bytes, memory_order_relaxed);
+}
+
+static void *
+exporter_run(void *arg)
+{
+    exporter_t *exporter = (exporter_t *)arg;
+    pthread_mutex_lock(&exporter->mutex);
+    while (!exporter->stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += exporter->interval / 1000;
+        deadline.tv_nsec += (exporter->interval % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (!exporter->stopping && pthread_cond_timedwait(&exporter->cond, &exporter->mutex, &deadline) == 0) {
+        }
+
+        if (exporter->stopping) {
+            break;
+        }
+
+        pthread_mutex_unlock(&exporter->mutex);
+        int error = (exporter_export(exporter) == -1) ? errno : 0;
+        pthread_mutex_lock(&exporter->mutex);
+        if (error != 0 && exporter->error == 0) {
+            exporter->error = error;
+        }
+    }
+
+    pthread_mutex_unlock(&exporter->mutex);
+    return NULL;
+}
+
+int
+exporter_start(exporter_t *restrict exporter)
+{
+    if (exporter->started) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    int error = pthread_create(&exporter->thread, NULL, exporter_run, exporter);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    exporter->started = 1;
+    return 0;
+}
+
+int
+exporter_stop(exporter_t *restrict exporter)
+{
+    if (!exporter->started) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&exporter->mutex);
+    exporter->stopping = 1;
+    pthread_cond_signal(&exporter->cond);
+    pthread_mutex_unlock(&exporter->mutex);
+    int error = pthread_join(exporter->thread, NULL);
+    exporter->started = 0;
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    if (exporter_export(exporter) == -1) {
+        return -1;
+    }
+
+    if (exporter->error != 0) {
+        errno = exporter->error;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+/** @file */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Exporter thread that periodically appends what was written to its files
+ * since the last export to copies in another directory (e.g., to keep the
+ * output files on tmpfs and export them to a disk that is not being fuzzed).
+ */
+typedef struct _exporter exporter_t;
+
+/**
+ * Adds a file to the exporter, creating (or truncating) its copy, with the same
+ * name, in the directory of the exporter. (Files must be added before the
+ * exporter is started.)
+ *
+ * @param [in] exporter Exporter.
+ * @param [in] filename File name.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int exporter_add_file(exporter_t *restrict exporter, const char *filename);
+
+/**
+ * Creates an exporter.
+ *
+ * @param [in] directory Directory the files are exported to.
+ * @param [in] interval Interval between exports, in milliseconds.
+ * @return An exporter, or NULL and errno is set to indicate the error.
+ */
+exporter_t *exporter_create(const char *directory, unsigned long interval);
+
+/**
+ * Destroys the exporter, stopping its thread if it is running.
+ *
+ * @param [in] exporter Exporter.
+ */
+void exporter_destroy(exporter_t *restrict exporter);
+
+/**
+ * Gets the number of bytes exported so far.
+ *
+ * @param [in] exporter Exporter.
+ * @return Number of bytes exported.
+ */
+uint64_t exporter_get_bytes(const exporter_t *restrict exporter);
+
+/**
+ * Starts the exporter thread.
+ *
+ * @param [in] exporter Exporter.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int exporter_start(exporter_t *restrict exporter);
+
+/**
+ * Stops the exporter thread after a last export. (The files must have been
+ * flushed.)
+ *
+ * @param [in] exporter Exporter.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error
+ *   of the last export.
+ */
+int exporter_stop(exporter_t *restrict exporter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXPORTER_H */
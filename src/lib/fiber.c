@@ -0,0 +1,228 @@
+/** @file */
+
+#include "fiber.h"
+
+#include "io_fuzzer.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct _fiber {
+    void *sp;
+    void *stack;
+    size_t stack_size;
+    fiber_function_t *function;
+    void *arg;
+    int done;
+    struct _fiber *next;
+} fiber_t;
+
+struct _fiber_scheduler {
+    void *sp;
+    fiber_t *fibers;
+    fiber_t *current;
+};
+
+static __thread fiber_scheduler_t *current_scheduler = NULL;
+
+/* Saves the callee-saved registers and the stack pointer of the current
+ * context in from and restores the context saved in to. */
+void fiber_switch(void **from, void *to);
+
+asm(".text\n"
+    ".type fiber_switch, @function\n"
+    "fiber_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size fiber_switch, .-fiber_switch\n");
+
+static void
+fiber_start(void)
+{
+    fiber_scheduler_t *scheduler = current_scheduler;
+    fiber_t *fiber = scheduler->current;
+    (*fiber->function)(fiber->arg);
+    fiber->done = 1;
+    fiber_switch(&fiber->sp, scheduler->sp);
+    abort();
+}
+
+static void
+fiber_free(fiber_t *fiber)
+{
+    munmap(fiber->stack, fiber->stack_size);
+    free(fiber);
+}
+
+fiber_scheduler_t *
+fiber_scheduler_create(void)
+{
+    return (fiber_scheduler_t *)calloc(1, sizeof(fiber_scheduler_t));
+}
+
+void
+fiber_scheduler_destroy(fiber_scheduler_t *restrict scheduler)
+{
+    if (scheduler == NULL) {
+        return;
+    }
+
+    fiber_t *fiber = scheduler->fibers;
+    while (fiber != NULL) {
+        fiber_t *next = fiber->next;
+        fiber_free(fiber);
+        fiber = next;
+    }
+
+    free(scheduler);
+}
+
+void
+fiber_scheduler_run(fiber_scheduler_t *restrict scheduler)
+{
+    fiber_scheduler_t *previous_scheduler = current_scheduler;
+    current_scheduler = scheduler;
+    while (scheduler->fibers != NULL) {
+        fiber_t **link = &scheduler->fibers;
+        while (*link != NULL) {
+            fiber_t *fiber = *link;
+            scheduler->current = fiber;
+            fiber_switch(&scheduler->sp, fiber->sp);
+            if (fiber->done) {
+                *link = fiber->next;
+                fiber_free(fiber);
+            } else {
+                link = &fiber->next;
+            }
+        }
+    }
+
+    scheduler->current = NULL;
+    current_scheduler = previous_scheduler;
+}
+
+int
+fiber_spawn(fiber_scheduler_t *restrict scheduler, fiber_function_t *function, void *arg, size_t stack_size)
+{
+    if (scheduler == NULL || function == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fiber_t *fiber = (fiber_t *)calloc(1, sizeof(*fiber));
+    if (fiber == NULL) {
+        return -1;
+    }
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    if (stack_size == 0) {
+        stack_size = FIBER_STACK_SIZE;
+    }
+
+    /* The lowest page of the stack is a guard page. */
+    fiber->stack_size = ((stack_size + (page_size - 1)) & ~(page_size - 1)) + page_size;
+    fiber->stack =
+            mmap(NULL, fiber->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (fiber->stack == MAP_FAILED) {
+        free(fiber);
+        return -1;
+    }
+
+    if (mprotect(fiber->stack, page_size, PROT_NONE) == -1) {
+        munmap(fiber->stack, fiber->stack_size);
+        free(fiber);
+        return -1;
+    }
+
+    /* The initial frame is restored by fiber_switch(), which returns to
+     * fiber_start() with the stack aligned as if it had been called. */
+    uintptr_t *sp = (uintptr_t *)((uint8_t *)fiber->stack + fiber->stack_size);
+    *--sp = 0;
+    *--sp = (uintptr_t)fiber_start;
+    for (int i = 0; i < 6; ++i) {
+        *--sp = 0;
+    }
+
+    fiber->sp = sp;
+    fiber->function = function;
+    fiber->arg = arg;
+    fiber_t **link = &scheduler->fibers;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+
+    *link = fiber;
+    return 0;
+}
+
+uint32_t
+fiber_execute(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *restrict operation)
+{
+    if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+        io_fuzzer_log_operation(io_fuzzer, operation);
+    }
+
+    uint32_t value = io_fuzzer_execute(io_fuzzer, operation);
+    io_fuzzer_log_responses(io_fuzzer);
+    return value;
+}
+
+#define _fiber_define(size, type) \
+    int fiber_wait##size(io_fuzzer_t *restrict io_fuzzer, uint16_t port, type mask, type value, \
+            unsigned long max_polls, type *result) \
+    { \
+        io_fuzzer_operation_t operation = {.function = IO_FUZZER_IO_READ##size, .port = port}; \
+        type current = 0; \
+        for (unsigned long i = 0; max_polls == 0 || i < max_polls; ++i) { \
+            current = fiber_execute(io_fuzzer, &operation); \
+            if ((current & mask) == value) { \
+                if (result != NULL) { \
+                    *result = current; \
+                } \
+\
+                return 0; \
+            } \
+\
+            fiber_yield(); \
+        } \
+\
+        if (result != NULL) { \
+            *result = current; \
+        } \
+\
+        return -1; \
+    }
+
+_fiber_define(16, uint16_t)
+_fiber_define(32, uint32_t)
+_fiber_define(8, uint8_t)
+#undef _fiber_define
+
+void
+fiber_yield(void)
+{
+    fiber_scheduler_t *scheduler = current_scheduler;
+    if (scheduler == NULL || scheduler->current == NULL) {
+        return;
+    }
+
+    fiber_switch(&scheduler->current->sp, scheduler->sp);
+}
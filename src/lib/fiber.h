@@ -0,0 +1,148 @@
+/** @file
+ *
+ * Cooperative scheduler of stackful fibers for writing device sequences that
+ * run interleaved on a single thread. A sequence that must wait for a device
+ * (e.g., for a status register bit to clear) yields to the other sequences
+ * between polls instead of spinning. Sequences perform their operations with
+ * fiber_execute(), so that they are timed, logged and their responses are
+ * captured like those of any other operation:
+ *
+ *     void sequence(void *arg)
+ *     {
+ *         io_fuzzer_operation_t command = {IO_FUZZER_IO_WRITE8, 0x1f7, 0, 0xec, NULL};
+ *         fiber_execute(io_fuzzer, &command);
+ *         fiber_wait8(io_fuzzer, 0x1f7, 0x80, 0x00, 1000, NULL);
+ *         ...
+ *     }
+ *
+ *     fiber_scheduler_t *scheduler = fiber_scheduler_create();
+ *     fiber_spawn(scheduler, sequence, NULL, 0);
+ *     fiber_spawn(scheduler, sequence, NULL, 0);
+ *     fiber_scheduler_run(scheduler);
+ *     fiber_scheduler_destroy(scheduler);
+ */
+
+#ifndef FIBER_H
+#define FIBER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "io_fuzzer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FIBER_STACK_SIZE (64 * 1024)
+
+typedef struct _fiber_scheduler fiber_scheduler_t; /**< Fiber scheduler. */
+
+typedef void fiber_function_t(void *arg);
+
+/**
+ * Creates a fiber scheduler.
+ *
+ * @return A fiber scheduler, or NULL and errno is set to indicate the error.
+ */
+fiber_scheduler_t *fiber_scheduler_create(void);
+
+/**
+ * Logs and performs an operation, and logs its response, using the I/O
+ * address space fuzzer. (The fiber does not yield.)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] operation Operation.
+ * @return Value read by a read operation; otherwise, 0.
+ */
+uint32_t fiber_execute(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *restrict operation);
+
+/**
+ * Destroys the fiber scheduler and all of its fibers.
+ *
+ * @param [in] scheduler Fiber scheduler.
+ */
+void fiber_scheduler_destroy(fiber_scheduler_t *restrict scheduler);
+
+/**
+ * Runs the fibers of the scheduler in turn on the calling thread until all of
+ * them have returned.
+ *
+ * @param [in] scheduler Fiber scheduler.
+ */
+void fiber_scheduler_run(fiber_scheduler_t *restrict scheduler);
+
+/**
+ * Creates a fiber.
+ *
+ * @param [in] scheduler Fiber scheduler.
+ * @param [in] function Function run by the fiber.
+ * @param [in] arg Argument passed to the function.
+ * @param [in] stack_size Size of the stack of the fiber, in bytes, or 0 for
+ *   FIBER_STACK_SIZE.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int fiber_spawn(fiber_scheduler_t *restrict scheduler, fiber_function_t *function, void *arg, size_t stack_size);
+
+/**
+ * Waits, yielding to the other fibers between polls, until the masked 16-bit
+ * value read from the I/O port is equal to the value. (Each poll is logged and
+ * performed with fiber_execute().)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] port I/O port address.
+ * @param [in] mask Mask.
+ * @param [in] value Value.
+ * @param [in] max_polls Maximum number of polls, or 0 for no limit.
+ * @param [out] result Last value read from the I/O port, or NULL.
+ * @return 0 on success; otherwise, -1 if the maximum number of polls was
+ *   reached.
+ */
+int fiber_wait16(io_fuzzer_t *restrict io_fuzzer, uint16_t port, uint16_t mask, uint16_t value, unsigned long max_polls,
+        uint16_t *result);
+
+/**
+ * Waits, yielding to the other fibers between polls, until the masked 32-bit
+ * value read from the I/O port is equal to the value. (Each poll is logged and
+ * performed with fiber_execute().)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] port I/O port address.
+ * @param [in] mask Mask.
+ * @param [in] value Value.
+ * @param [in] max_polls Maximum number of polls, or 0 for no limit.
+ * @param [out] result Last value read from the I/O port, or NULL.
+ * @return 0 on success; otherwise, -1 if the maximum number of polls was
+ *   reached.
+ */
+int fiber_wait32(io_fuzzer_t *restrict io_fuzzer, uint16_t port, uint32_t mask, uint32_t value, unsigned long max_polls,
+        uint32_t *result);
+
+/**
+ * Waits, yielding to the other fibers between polls, until the masked 8-bit
+ * value read from the I/O port is equal to the value. (Each poll is logged and
+ * performed with fiber_execute().)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] port I/O port address.
+ * @param [in] mask Mask.
+ * @param [in] value Value.
+ * @param [in] max_polls Maximum number of polls, or 0 for no limit.
+ * @param [out] result Last value read from the I/O port, or NULL.
+ * @return 0 on success; otherwise, -1 if the maximum number of polls was
+ *   reached.
+ */
+int fiber_wait8(io_fuzzer_t *restrict io_fuzzer, uint16_t port, uint8_t mask, uint8_t value, unsigned long max_polls,
+        uint8_t *result);
+
+/**
+ * Yields the calling fiber to the next fiber of its scheduler. (Does nothing
+ * if not called from a fiber.)
+ */
+void fiber_yield(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIBER_H */
@@ -7,36 +7,91 @@
 extern "C" {
 #endif
 
+#include "tsc.h"
+
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+/*
+ * With IO_DRY_RUN defined, the in and out instructions are not executed, and
+ * reads return all ones, as from a port with no device (e.g., to measure the
+ * cost of the fuzzer itself where the ports cannot be accessed). It is defined
+ * only for iofuzzer-bench-dry-run, and the programs that access devices fail
+ * to build with it.
+ */
+#ifdef IO_DRY_RUN
+#define _io_asm(...) \
+    do { \
+    } while (0)
+#define _io_fill(string, count) memset((string), 0xff, (count) * sizeof(*(string)))
+#else
+#define _io_asm(...) asm volatile(__VA_ARGS__)
+#define _io_fill(string, count) \
+    do { \
+    } while (0)
+#endif
 
 #define _io_define(size, type, suffix, modifier) \
     static inline type io_read##size(uint16_t port) \
     { \
-        type value; \
-        asm volatile("in" #suffix " %w1, %" #modifier "0" : "=a"(value) : "Nd"(port)); \
+        type value = (type)~0; \
+        _io_asm("in" #suffix " %w1, %" #modifier "0" : "=a"(value) : "Nd"(port)); \
         return value; \
     } \
 \
     static inline void io_read_string##size(uint16_t port, type *string, size_t count) \
     { \
-        asm volatile("rep; ins" #suffix : "+D"(string), "+c"(count) : "d"(port) : "memory"); \
+        _io_fill(string, count); \
+        _io_asm("rep; ins" #suffix : "+D"(string), "+c"(count) : "d"(port) : "memory"); \
     } \
 \
     static inline void io_write##size(uint16_t port, type value) \
     { \
-        asm volatile("out" #suffix " %" #modifier "0, %w1" : : "a"(value), "Nd"(port)); \
+        _io_asm("out" #suffix " %" #modifier "0, %w1" : : "a"(value), "Nd"(port)); \
     } \
 \
     static inline void io_write_string##size(uint16_t port, const type *string, size_t count) \
     { \
-        asm volatile("rep; outs" #suffix : "+S"(string), "+c"(count) : "d"(port) : "memory"); \
+        _io_asm("rep; outs" #suffix : "+S"(string), "+c"(count) : "d"(port) : "memory"); \
+    } \
+\
+    static inline type io_read##size##_timed(uint16_t port, uint64_t *cycles) \
+    { \
+        uint64_t begin = tsc_begin(); \
+        type value = io_read##size(port); \
+        *cycles = tsc_end() - begin; \
+        return value; \
+    } \
+\
+    static inline void io_read_string##size##_timed(uint16_t port, type *string, size_t count, uint64_t *cycles) \
+    { \
+        uint64_t begin = tsc_begin(); \
+        io_read_string##size(port, string, count); \
+        *cycles = tsc_end() - begin; \
+    } \
+\
+    static inline void io_write##size##_timed(uint16_t port, type value, uint64_t *cycles) \
+    { \
+        uint64_t begin = tsc_begin(); \
+        io_write##size(port, value); \
+        *cycles = tsc_end() - begin; \
+    } \
+\
+    static inline void io_write_string##size##_timed( \
+            uint16_t port, const type *string, size_t count, uint64_t *cycles) \
+    { \
+        uint64_t begin = tsc_begin(); \
+        io_write_string##size(port, string, count); \
+        *cycles = tsc_end() - begin; \
     }
 
 _io_define(16, uint16_t, w, w)
 _io_define(32, uint32_t, l, k)
 _io_define(8, uint8_t, b, b)
 #undef _io_define
+#undef _io_asm
+#undef _io_fill
 
 #ifdef __cplusplus
 }
@@ -2,29 +2,86 @@
 
 #include "io_fuzzer.h"
 
+#include "crc.h"
 #include "input.h"
 #include "io.h"
 
+#include "trace.h"
+#include "tsc.h"
+
 #include <errno.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #define MAX_PORTS 65536
-#define MAX_STRING (sizeof(uint32_t) * UINT16_MAX)
+#define MAX_STRING IO_FUZZER_MAX_STRING
+
+typedef struct _io_fuzzer_response {
+    io_fuzzer_operation_t operation;
+    uint32_t value;
+    uint64_t latency;
+    uint64_t tsc;
+} io_fuzzer_response_t;
 
 struct _io_fuzzer {
     const int *ports;
     size_t num_ports;
     io_fuzzer_log_handler_t *log_handler;
-    FILE *log_stream;
+    void *log_context;
+    uint64_t sequence;
+    const tsc_clock_t *clock;
+    int capture;
+    io_fuzzer_response_t *responses;
+    size_t num_responses;
+    size_t max_responses;
+    uint64_t latency;
+    uint64_t latency_sequence;
+    const io_fuzzer_operation_t *logged;
+    uint64_t logged_sequence;
+    uint64_t num_executed;
+    uint64_t total_latency;
+    uint64_t max_latency;
 };
 
 static io_fuzzer_error_handler_t *error_handler = NULL;
 
+int io_fuzzer_log_level = IO_FUZZER_LOG_NORMAL;
+
+static const char *function_names[IO_FUZZER_NUM_FUNCTIONS] = {
+    "io_read16",
+    "io_read32",
+    "io_read8",
+    "io_read_string16",
+    "io_read_string32",
+    "io_read_string8",
+    "io_write16",
+    "io_write32",
+    "io_write8",
+    "io_write_string16",
+    "io_write_string32",
+    "io_write_string8",
+};
+
+static const uint8_t function_widths[IO_FUZZER_NUM_FUNCTIONS] = {
+    sizeof(uint16_t),
+    sizeof(uint32_t),
+    sizeof(uint8_t),
+    sizeof(uint16_t),
+    sizeof(uint32_t),
+    sizeof(uint8_t),
+    sizeof(uint16_t),
+    sizeof(uint32_t),
+    sizeof(uint8_t),
+    sizeof(uint16_t),
+    sizeof(uint32_t),
+    sizeof(uint8_t),
+};
+
 void io_fuzzer_error(io_fuzzer_t *restrict io_fuzzer, int status, int error, const char *restrict format, ...);
-void io_fuzzer_log(io_fuzzer_t *restrict io_fuzzer, const char *restrict format, ...);
 
 io_fuzzer_t *
 io_fuzzer_create(const int *ports, size_t num_ports)
@@ -37,6 +94,7 @@ io_fuzzer_create(const int *ports, size_t num_ports)
 
     io_fuzzer->ports = ports;
     io_fuzzer->num_ports = num_ports;
+    io_fuzzer->latency_sequence = UINT64_MAX;
     return io_fuzzer;
 }
 
@@ -47,6 +105,7 @@ io_fuzzer_destroy(io_fuzzer_t *restrict io_fuzzer)
         return;
     }
 
+    free(io_fuzzer->responses);
     free(io_fuzzer);
 }
 
@@ -64,125 +123,386 @@ io_fuzzer_error(io_fuzzer_t *restrict io_fuzzer, int status, int error, const ch
 }
 
 void
-io_fuzzer_iterate(io_fuzzer_t *restrict io_fuzzer, FILE *restrict stream)
+io_fuzzer_decode(io_fuzzer_t *restrict io_fuzzer, FILE *restrict stream, io_fuzzer_operation_t *restrict operation)
 {
-    uint16_t port = 0;
     if (io_fuzzer->ports == NULL || io_fuzzer->num_ports == 0) {
-        port = input_derive_range(stream, 0, MAX_PORTS - 1);
+        operation->port = input_derive_range(stream, 0, MAX_PORTS - 1);
     } else {
         size_t port_num = input_derive_range(stream, 0, io_fuzzer->num_ports - 1);
-        port = io_fuzzer->ports[port_num];
+        operation->port = io_fuzzer->ports[port_num];
     }
 
-    uint8_t string[MAX_STRING];
-    switch (input_derive_range(stream, 0, 11)) {
-    case 0: {
-        io_fuzzer_log(io_fuzzer, "su", "function", "io_read16", "port", port);
-        io_read16(port);
+    operation->function = input_derive_range(stream, 0, IO_FUZZER_NUM_FUNCTIONS - 1);
+    operation->count = 0;
+    operation->value = 0;
+    switch (operation->function) {
+    case IO_FUZZER_IO_READ16:
+    case IO_FUZZER_IO_READ32:
+    case IO_FUZZER_IO_READ8:
         break;
-    }
 
-    case 1: {
-        io_fuzzer_log(io_fuzzer, "su", "function", "io_read32", "port", port);
-        io_read32(port);
+    case IO_FUZZER_IO_READ_STRING16:
+    case IO_FUZZER_IO_READ_STRING32:
+    case IO_FUZZER_IO_READ_STRING8:
+        operation->count = input_read16(stream);
         break;
-    }
 
-    case 2: {
-        io_fuzzer_log(io_fuzzer, "su", "function", "io_read8", "port", port);
-        io_read8(port);
+    case IO_FUZZER_IO_WRITE16:
+        operation->value = input_read16(stream);
         break;
-    }
 
-    case 3: {
-        size_t count = input_read16(stream);
-        io_fuzzer_log(
-                io_fuzzer, "suuu", "function", "io_read_string16", "port", port, "string", string, "count", count);
-        io_read_string16(port, (uint16_t *)string, count);
+    case IO_FUZZER_IO_WRITE32:
+        operation->value = input_read32(stream);
         break;
-    }
 
-    case 4: {
-        size_t count = input_read16(stream);
-        io_fuzzer_log(
-                io_fuzzer, "suuu", "function", "io_read_string32", "port", port, "string", string, "count", count);
-        io_read_string32(port, (uint32_t *)string, count);
+    case IO_FUZZER_IO_WRITE8:
+        operation->value = input_read8(stream);
         break;
-    }
 
-    case 5: {
-        size_t count = input_read16(stream);
-        io_fuzzer_log(io_fuzzer, "suuu", "function", "io_read_string8", "port", port, "string", string, "count", count);
-        io_read_string8(port, string, count);
+    case IO_FUZZER_IO_WRITE_STRING16:
+        operation->count = input_read16(stream);
+        input_read_string16(stream, (uint16_t *)operation->string, operation->count);
         break;
-    }
 
-    case 6: {
-        uint16_t value = input_read16(stream);
-        io_fuzzer_log(io_fuzzer, "suu", "function", "io_write16", "port", port, "value", value);
-        io_write16(port, value);
+    case IO_FUZZER_IO_WRITE_STRING32:
+        operation->count = input_read16(stream);
+        input_read_string32(stream, (uint32_t *)operation->string, operation->count);
         break;
-    }
 
-    case 7: {
-        uint32_t value = input_read32(stream);
-        io_fuzzer_log(io_fuzzer, "suu", "function", "io_write32", "port", port, "value", value);
-        io_write32(port, value);
+    case IO_FUZZER_IO_WRITE_STRING8:
+        operation->count = input_read16(stream);
+        input_read_string8(stream, (uint8_t *)operation->string, operation->count);
         break;
+
+    default:
+        abort();
     }
+}
 
-    case 8: {
-        uint8_t value = input_read8(stream);
-        io_fuzzer_log(io_fuzzer, "suu", "function", "io_write8", "port", port, "value", value);
-        io_write8(port, value);
+uint32_t
+io_fuzzer_execute(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *restrict operation)
+{
+    uint16_t port = operation->port;
+    uint64_t latency = 0;
+    uint32_t value = 0;
+    switch (operation->function) {
+    case IO_FUZZER_IO_READ16:
+        value = io_read16_timed(port, &latency);
         break;
-    }
 
-    case 9: {
-        size_t count = input_read16(stream);
-        input_read_string16(stream, (uint16_t *)string, count);
-        io_fuzzer_log(
-                io_fuzzer, "suuu", "function", "io_write_string16", "port", port, "string", string, "count", count);
-        io_write_string16(port, (uint16_t *)string, count);
+    case IO_FUZZER_IO_READ32:
+        value = io_read32_timed(port, &latency);
         break;
-    }
 
-    case 10: {
-        size_t count = input_read16(stream);
-        input_read_string32(stream, (uint32_t *)string, count);
-        io_fuzzer_log(
-                io_fuzzer, "suuu", "function", "io_write_string32", "port", port, "string", string, "count", count);
-        io_write_string32(port, (uint32_t *)string, count);
+    case IO_FUZZER_IO_READ8:
+        value = io_read8_timed(port, &latency);
         break;
-    }
 
-    case 11: {
-        size_t count = input_read16(stream);
-        input_read_string8(stream, string, count);
-        io_fuzzer_log(
-                io_fuzzer, "suuu", "function", "io_write_string8", "port", port, "string", string, "count", count);
-        io_write_string8(port, string, count);
+    case IO_FUZZER_IO_READ_STRING16:
+        io_read_string16_timed(port, (uint16_t *)operation->string, operation->count, &latency);
+        break;
+
+    case IO_FUZZER_IO_READ_STRING32:
+        io_read_string32_timed(port, (uint32_t *)operation->string, operation->count, &latency);
+        break;
+
+    case IO_FUZZER_IO_READ_STRING8:
+        io_read_string8_timed(port, (uint8_t *)operation->string, operation->count, &latency);
+        break;
+
+    case IO_FUZZER_IO_WRITE16:
+        io_write16_timed(port, operation->value, &latency);
+        break;
+
+    case IO_FUZZER_IO_WRITE32:
+        io_write32_timed(port, operation->value, &latency);
+        break;
+
+    case IO_FUZZER_IO_WRITE8:
+        io_write8_timed(port, operation->value, &latency);
+        break;
+
+    case IO_FUZZER_IO_WRITE_STRING16:
+        io_write_string16_timed(port, (const uint16_t *)operation->string, operation->count, &latency);
+        break;
+
+    case IO_FUZZER_IO_WRITE_STRING32:
+        io_write_string32_timed(port, (const uint32_t *)operation->string, operation->count, &latency);
+        break;
+
+    case IO_FUZZER_IO_WRITE_STRING8:
+        io_write_string8_timed(port, (const uint8_t *)operation->string, operation->count, &latency);
         break;
-    }
 
     default:
         abort();
     }
+
+    /*
+     * The latency is logged with the next record only if it follows the record
+     * of this operation (i.e., not if the operations were logged in a batch).
+     */
+    io_fuzzer->latency = latency;
+    io_fuzzer->latency_sequence =
+            (operation == io_fuzzer->logged && io_fuzzer->logged_sequence + 1 == io_fuzzer->sequence)
+            ? io_fuzzer->sequence
+            : UINT64_MAX;
+    ++io_fuzzer->num_executed;
+    io_fuzzer->total_latency += latency;
+    if (latency > io_fuzzer->max_latency) {
+        io_fuzzer->max_latency = latency;
+    }
+
+    /* Responses are only logged by io_fuzzer_log_responses(), after the operations being timed. */
+    if (io_fuzzer->capture != IO_FUZZER_CAPTURE_NONE && operation->function < IO_FUZZER_IO_WRITE16
+            && io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+        if (io_fuzzer->num_responses == io_fuzzer->max_responses) {
+            io_fuzzer_log_responses(io_fuzzer);
+        }
+
+        io_fuzzer_response_t *response = &io_fuzzer->responses[io_fuzzer->num_responses++];
+        response->operation = *operation;
+        response->value = value;
+        response->latency = latency;
+        response->tsc = (io_fuzzer->clock != NULL) ? tsc_read() : 0;
+    }
+
+    if (io_fuzzer_log_enabled(IO_FUZZER_LOG_DEBUG)) {
+        /* Reads print the value read, or the count and CRC-32C of the string read, as in the response records. */
+        switch (operation->function) {
+        case IO_FUZZER_IO_READ16:
+        case IO_FUZZER_IO_READ32:
+        case IO_FUZZER_IO_READ8:
+            io_fuzzer_print("%s: port 0x%04x, value read 0x%x, %llu cycles\n", function_names[operation->function],
+                    port, value, (unsigned long long)latency);
+            break;
+
+        case IO_FUZZER_IO_READ_STRING16:
+        case IO_FUZZER_IO_READ_STRING32:
+        case IO_FUZZER_IO_READ_STRING8:
+            io_fuzzer_print("%s: port 0x%04x, count %zu, crc32c 0x%08x, %llu cycles\n",
+                    function_names[operation->function], port, operation->count,
+                    crc32c(0, operation->string, io_fuzzer_operation_size(operation)), (unsigned long long)latency);
+            break;
+
+        default:
+            io_fuzzer_print("%s: port 0x%04x, value 0x%x, count %zu, %llu cycles\n",
+                    function_names[operation->function], port, operation->value, operation->count,
+                    (unsigned long long)latency);
+            break;
+        }
+    }
+
+    return value;
 }
 
 void
-io_fuzzer_log(io_fuzzer_t *restrict io_fuzzer, const char *restrict format, ...)
+io_fuzzer_iterate(io_fuzzer_t *restrict io_fuzzer, FILE *restrict stream)
+{
+    uint8_t string[MAX_STRING];
+    io_fuzzer_operation_t operation = {.string = string};
+    io_fuzzer_decode(io_fuzzer, stream, &operation);
+    if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+        io_fuzzer_log_operation(io_fuzzer, &operation);
+    }
+
+    io_fuzzer_execute(io_fuzzer, &operation);
+    io_fuzzer_log_responses(io_fuzzer);
+}
+
+static void
+io_fuzzer_log_at(io_fuzzer_t *restrict io_fuzzer, trace_record_t *restrict record, uint64_t tsc)
 {
     if (io_fuzzer->log_handler == NULL) {
         return;
     }
 
+    record->sequence = io_fuzzer->sequence++;
+    if (io_fuzzer->clock != NULL) {
+        const tsc_clock_t *clock = io_fuzzer->clock;
+        record->time = clock->time + tsc_clock_to_ns(clock, ((tsc != 0) ? tsc : tsc_read()) - clock->tsc);
+    } else {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        record->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    (*io_fuzzer->log_handler)(io_fuzzer->log_context, record);
+}
+
+void
+io_fuzzer_log(io_fuzzer_t *restrict io_fuzzer, trace_record_t *restrict record)
+{
+    io_fuzzer_log_at(io_fuzzer, record, 0);
+}
+
+void
+io_fuzzer_log_operation(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *restrict operation)
+{
+    trace_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.function = operation->function;
+    record.width = function_widths[operation->function];
+    record.port = operation->port;
+    record.value = operation->value;
+    record.count = operation->count;
+    if (io_fuzzer->clock != NULL && io_fuzzer->latency_sequence == io_fuzzer->sequence) {
+        uint64_t latency = tsc_clock_to_ns(io_fuzzer->clock, io_fuzzer->latency);
+        record.latency = (latency > UINT32_MAX) ? UINT32_MAX : latency;
+    }
+
+    switch (operation->function) {
+    case IO_FUZZER_IO_READ_STRING16:
+    case IO_FUZZER_IO_READ_STRING32:
+    case IO_FUZZER_IO_READ_STRING8:
+    case IO_FUZZER_IO_WRITE_STRING16:
+    case IO_FUZZER_IO_WRITE_STRING32:
+    case IO_FUZZER_IO_WRITE_STRING8:
+        record.payload = (uintptr_t)operation->string;
+        break;
+
+    default:
+        break;
+    }
+
+    io_fuzzer_log(io_fuzzer, &record);
+    io_fuzzer->logged = operation;
+    io_fuzzer->logged_sequence = record.sequence;
+}
+
+void
+io_fuzzer_print(const char *restrict format, ...)
+{
     va_list ap;
     va_start(ap, format);
-    (*io_fuzzer->log_handler)(io_fuzzer->log_stream, format, ap);
+    vfprintf(stderr, format, ap);
     va_end(ap);
 }
 
+void
+io_fuzzer_log_responses(io_fuzzer_t *restrict io_fuzzer)
+{
+    for (size_t i = 0; i < io_fuzzer->num_responses; ++i) {
+        const io_fuzzer_response_t *response = &io_fuzzer->responses[i];
+        const io_fuzzer_operation_t *operation = &response->operation;
+        trace_record_t record;
+        memset(&record, 0, sizeof(record));
+        switch (operation->function) {
+        case IO_FUZZER_IO_READ16:
+        case IO_FUZZER_IO_READ32:
+        case IO_FUZZER_IO_READ8:
+            record.function = TRACE_FUNCTION_RESPONSE;
+            record.value = response->value;
+            break;
+
+        case IO_FUZZER_IO_READ_STRING16:
+        case IO_FUZZER_IO_READ_STRING32:
+        case IO_FUZZER_IO_READ_STRING8:
+            record.function = TRACE_FUNCTION_RESPONSE_STRING;
+            record.value = crc32c(0, operation->string, io_fuzzer_operation_size(operation));
+            record.count = operation->count;
+            if (io_fuzzer->capture == IO_FUZZER_CAPTURE_STRINGS) {
+                record.payload = (uintptr_t)operation->string;
+            }
+
+            break;
+
+        default:
+            abort();
+        }
+
+        record.width = function_widths[operation->function];
+        record.port = operation->port;
+        if (io_fuzzer->clock != NULL) {
+            uint64_t latency = tsc_clock_to_ns(io_fuzzer->clock, response->latency);
+            record.latency = (latency > UINT32_MAX) ? UINT32_MAX : latency;
+        }
+
+        io_fuzzer_log_at(io_fuzzer, &record, response->tsc);
+    }
+
+    io_fuzzer->num_responses = 0;
+}
+
+size_t
+io_fuzzer_operation_size(const io_fuzzer_operation_t *restrict operation)
+{
+    switch (operation->function) {
+    case IO_FUZZER_IO_READ_STRING16:
+    case IO_FUZZER_IO_WRITE_STRING16:
+        return operation->count * sizeof(uint16_t);
+
+    case IO_FUZZER_IO_READ_STRING32:
+    case IO_FUZZER_IO_WRITE_STRING32:
+        return operation->count * sizeof(uint32_t);
+
+    case IO_FUZZER_IO_READ_STRING8:
+    case IO_FUZZER_IO_WRITE_STRING8:
+        return operation->count * sizeof(uint8_t);
+
+    default:
+        return 0;
+    }
+}
+
+const char *
+io_fuzzer_function_name(int function)
+{
+    if (function < 0 || function >= IO_FUZZER_NUM_FUNCTIONS) {
+        return NULL;
+    }
+
+    return function_names[function];
+}
+
+size_t
+io_fuzzer_function_width(int function)
+{
+    if (function < 0 || function >= IO_FUZZER_NUM_FUNCTIONS) {
+        return 0;
+    }
+
+    return function_widths[function];
+}
+
+void
+io_fuzzer_get_latency(const io_fuzzer_t *restrict io_fuzzer, uint64_t *num_operations, uint64_t *total, uint64_t *max)
+{
+    *num_operations = io_fuzzer->num_executed;
+    *total = io_fuzzer->total_latency;
+    *max = io_fuzzer->max_latency;
+}
+
+int
+io_fuzzer_set_capture(io_fuzzer_t *restrict io_fuzzer, int capture, size_t max_responses)
+{
+    io_fuzzer_response_t *responses = NULL;
+    if (capture != IO_FUZZER_CAPTURE_NONE) {
+        if (max_responses == 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        responses = (io_fuzzer_response_t *)calloc(max_responses, sizeof(*responses));
+        if (responses == NULL) {
+            return -1;
+        }
+    }
+
+    io_fuzzer_log_responses(io_fuzzer);
+    free(io_fuzzer->responses);
+    io_fuzzer->capture = capture;
+    io_fuzzer->responses = responses;
+    io_fuzzer->max_responses = (responses != NULL) ? max_responses : 0;
+    return 0;
+}
+
+void
+io_fuzzer_set_clock(io_fuzzer_t *restrict io_fuzzer, const tsc_clock_t *clock)
+{
+    io_fuzzer->clock = clock;
+}
+
 io_fuzzer_error_handler_t *
 io_fuzzer_set_error_handler(io_fuzzer_error_handler_t *handler)
 {
@@ -191,6 +511,14 @@ io_fuzzer_set_error_handler(io_fuzzer_error_handler_t *handler)
     return previous_handler;
 }
 
+int
+io_fuzzer_set_log_level(int level)
+{
+    int previous_level = io_fuzzer_log_level;
+    io_fuzzer_log_level = (level > IO_FUZZER_MAX_LOG_LEVEL) ? IO_FUZZER_MAX_LOG_LEVEL : level;
+    return previous_level;
+}
+
 io_fuzzer_log_handler_t *
 io_fuzzer_set_log_handler(io_fuzzer_t *restrict io_fuzzer, io_fuzzer_log_handler_t *handler)
 {
@@ -199,10 +527,10 @@ io_fuzzer_set_log_handler(io_fuzzer_t *restrict io_fuzzer, io_fuzzer_log_handler
     return previous_handler;
 }
 
-FILE *
-io_fuzzer_set_log_stream(io_fuzzer_t *restrict io_fuzzer, FILE *stream)
+void *
+io_fuzzer_set_log_context(io_fuzzer_t *restrict io_fuzzer, void *context)
 {
-    FILE *previous_stream = io_fuzzer->log_stream;
-    io_fuzzer->log_stream = stream;
-    return previous_stream;
+    void *previous_context = io_fuzzer->log_context;
+    io_fuzzer->log_context = context;
+    return previous_context;
 }
@@ -7,16 +7,89 @@
 extern "C" {
 #endif
 
+#include "trace.h"
+#include "tsc.h"
+
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
 #define IO_FUZZER_MAX_INPUT (20 + (sizeof(uint32_t) * UINT16_MAX))
+#define IO_FUZZER_MAX_STRING (sizeof(uint32_t) * UINT16_MAX)
+
+#ifndef IO_FUZZER_MAX_LOG_LEVEL
+#define IO_FUZZER_MAX_LOG_LEVEL IO_FUZZER_LOG_DEBUG /**< Most verbose log level compiled in. */
+#endif
+
+/**
+ * Checks whether the log level is enabled. Levels above
+ * IO_FUZZER_MAX_LOG_LEVEL are discarded at compile time; other levels cost a
+ * single branch, predicted taken for the normal level and untaken for the
+ * verbose and debug levels.
+ */
+#define io_fuzzer_log_enabled(level) \
+    ((level) <= IO_FUZZER_MAX_LOG_LEVEL && \
+            __builtin_expect((level) <= io_fuzzer_log_level, (level) <= IO_FUZZER_LOG_NORMAL))
+
+/**
+ * Prints a message to the standard error if the log level is enabled. (The
+ * arguments are not evaluated otherwise.)
+ */
+#define io_fuzzer_message(level, ...) \
+    do { \
+        if (io_fuzzer_log_enabled(level)) { \
+            io_fuzzer_print(__VA_ARGS__); \
+        } \
+    } while (0)
+
+/** I/O address space fuzzer functions. */
+enum {
+    IO_FUZZER_IO_READ16,
+    IO_FUZZER_IO_READ32,
+    IO_FUZZER_IO_READ8,
+    IO_FUZZER_IO_READ_STRING16,
+    IO_FUZZER_IO_READ_STRING32,
+    IO_FUZZER_IO_READ_STRING8,
+    IO_FUZZER_IO_WRITE16,
+    IO_FUZZER_IO_WRITE32,
+    IO_FUZZER_IO_WRITE8,
+    IO_FUZZER_IO_WRITE_STRING16,
+    IO_FUZZER_IO_WRITE_STRING32,
+    IO_FUZZER_IO_WRITE_STRING8,
+    IO_FUZZER_NUM_FUNCTIONS
+};
+
+/** Capture modes of the responses of read operations. */
+enum {
+    IO_FUZZER_CAPTURE_NONE,    /**< Responses are not logged. */
+    IO_FUZZER_CAPTURE_READS,   /**< Values read and CRC-32C of strings read are logged. */
+    IO_FUZZER_CAPTURE_STRINGS, /**< Addresses of strings read are also logged. */
+};
+
+/** Log levels. */
+enum {
+    IO_FUZZER_LOG_QUIET,   /**< Nothing is logged. */
+    IO_FUZZER_LOG_NORMAL,  /**< Records, warnings and the summary are logged. */
+    IO_FUZZER_LOG_VERBOSE, /**< The configuration of the workers is also logged. */
+    IO_FUZZER_LOG_DEBUG,   /**< Every operation performed is also logged. */
+};
 
 typedef struct _io_fuzzer io_fuzzer_t; /**< I/O address space fuzzer. */
 
+/** I/O address space fuzzer operation. */
+typedef struct _io_fuzzer_operation {
+    int function;   /**< Function. */
+    uint16_t port;  /**< I/O port address. */
+    size_t count;   /**< Number of values of the string. */
+    uint32_t value; /**< Value to be written. */
+    void *string;   /**< String of at least IO_FUZZER_MAX_STRING bytes. */
+} io_fuzzer_operation_t;
+
 typedef void io_fuzzer_error_handler_t(int status, int error, const char *restrict format, va_list ap);
-typedef void io_fuzzer_log_handler_t(FILE *restrict stream, const char *restrict format, va_list ap);
+typedef void io_fuzzer_log_handler_t(void *restrict context, const trace_record_t *restrict record);
+
+extern int io_fuzzer_log_level; /**< Log level. (Set with io_fuzzer_set_log_level().) */
 
 /**
  * Creates an I/O address space fuzzer.
@@ -28,6 +101,16 @@ typedef void io_fuzzer_log_handler_t(FILE *restrict stream, const char *restrict
  */
 io_fuzzer_t *io_fuzzer_create(const int *ports, size_t num_ports);
 
+/**
+ * Decodes an operation from the input without performing it.
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] stream Input stream.
+ * @param [in,out] operation Operation. (The string must be set by the caller.)
+ */
+void io_fuzzer_decode(
+        io_fuzzer_t *restrict io_fuzzer, FILE *restrict stream, io_fuzzer_operation_t *restrict operation);
+
 /**
  * Destroys the I/O address space fuzzer.
  *
@@ -36,13 +119,130 @@ io_fuzzer_t *io_fuzzer_create(const int *ports, size_t num_ports);
 void io_fuzzer_destroy(io_fuzzer_t *restrict io_fuzzer);
 
 /**
- * Performs an iteration.
+ * Performs an operation. (The response of a read operation is kept until it
+ * is logged by io_fuzzer_log_responses().)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] operation Operation.
+ * @return Value read by a read operation (i.e., IO_FUZZER_IO_READ16,
+ *   IO_FUZZER_IO_READ32, or IO_FUZZER_IO_READ8); otherwise, 0.
+ */
+uint32_t io_fuzzer_execute(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *restrict operation);
+
+/**
+ * Gets the name of a function.
+ *
+ * @param [in] function Function.
+ * @return Name of the function, or NULL if it is not an I/O address space
+ *   fuzzer function.
+ */
+const char *io_fuzzer_function_name(int function);
+
+/**
+ * Gets the size of each value of a function.
+ *
+ * @param [in] function Function.
+ * @return Size of each value, in bytes, or 0 if it is not an I/O address space
+ *   fuzzer function.
+ */
+size_t io_fuzzer_function_width(int function);
+
+/**
+ * Gets the latency statistics of the operations performed by the I/O address
+ * space fuzzer, measured with the time-stamp counter around each instruction.
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [out] num_operations Number of operations performed.
+ * @param [out] total Total latency, in time-stamp counter cycles.
+ * @param [out] max Maximum latency, in time-stamp counter cycles.
+ */
+void io_fuzzer_get_latency(
+        const io_fuzzer_t *restrict io_fuzzer, uint64_t *num_operations, uint64_t *total, uint64_t *max);
+
+/**
+ * Performs an iteration (i.e., decodes, logs and performs an operation, and
+ * logs its response).
  *
  * @param [in] io_fuzzer I/O address space fuzzer.
  * @param [in] stream Input stream.
  */
 void io_fuzzer_iterate(io_fuzzer_t *restrict io_fuzzer, FILE *restrict stream);
 
+/**
+ * Logs a record using the log handler of the I/O address space fuzzer. (The
+ * sequence number and time of the record are set by this function. The time is
+ * read from the time-stamp counter if a clock is set. Callers check
+ * io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL) before constructing the record.)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in,out] record Trace record.
+ */
+void io_fuzzer_log(io_fuzzer_t *restrict io_fuzzer, trace_record_t *restrict record);
+
+/**
+ * Logs an operation using the log handler of the I/O address space fuzzer.
+ * Operations are logged before they are performed, so the record has the
+ * latency of the previous operation performed, if a clock is set and the
+ * previous record is that of the operation (i.e., not if the operations were
+ * logged in a batch before being performed, as in race and pipeline modes).
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] operation Operation.
+ */
+void io_fuzzer_log_operation(io_fuzzer_t *restrict io_fuzzer, const io_fuzzer_operation_t *restrict operation);
+
+/**
+ * Prints a message to the standard error. (Use io_fuzzer_message() instead.)
+ *
+ * @param [in] format Format string.
+ */
+void io_fuzzer_print(const char *restrict format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * Logs the responses of the read operations performed since the last call
+ * (i.e., the value read, or the count and CRC-32C of the string read) as
+ * response records using the log handler of the I/O address space fuzzer.
+ * (Responses are kept by io_fuzzer_execute() if the capture mode is not
+ * IO_FUZZER_CAPTURE_NONE, so that they are not logged while operations are
+ * being timed. Each record has the time and latency of the read operation. The
+ * strings read must not be modified before this function is called.)
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ */
+void io_fuzzer_log_responses(io_fuzzer_t *restrict io_fuzzer);
+
+/**
+ * Gets the size, in bytes, of the string of an operation.
+ *
+ * @param [in] operation Operation.
+ * @return Size, in bytes, of the string of the operation, or 0 if the
+ *   operation has no string.
+ */
+size_t io_fuzzer_operation_size(const io_fuzzer_operation_t *restrict operation);
+
+/**
+ * Sets the capture mode of the responses of read operations of the I/O address
+ * space fuzzer.
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] capture Capture mode (i.e., IO_FUZZER_CAPTURE_NONE,
+ *   IO_FUZZER_CAPTURE_READS, or IO_FUZZER_CAPTURE_STRINGS).
+ * @param [in] max_responses Maximum number of responses kept until they are
+ *   logged by io_fuzzer_log_responses(). (They are logged by
+ *   io_fuzzer_execute() before another is kept if there are already as many.)
+ * @return 0 on success; otherwise, -1 and errno is set.
+ */
+int io_fuzzer_set_capture(io_fuzzer_t *restrict io_fuzzer, int capture, size_t max_responses);
+
+/**
+ * Sets the clock of the I/O address space fuzzer, used for the time and
+ * latency of the records.
+ *
+ * @param [in] io_fuzzer I/O address space fuzzer.
+ * @param [in] clock Clock, or NULL to use the realtime clock.
+ */
+void io_fuzzer_set_clock(io_fuzzer_t *restrict io_fuzzer, const tsc_clock_t *clock);
+
 /**
  * Sets the error handler for the I/O address space fuzzer.
  *
@@ -51,6 +251,14 @@ void io_fuzzer_iterate(io_fuzzer_t *restrict io_fuzzer, FILE *restrict stream);
  */
 io_fuzzer_error_handler_t *io_fuzzer_set_error_handler(io_fuzzer_error_handler_t *handler);
 
+/**
+ * Sets the log level for all I/O address space fuzzers.
+ *
+ * @param [in] level Log level (capped to IO_FUZZER_MAX_LOG_LEVEL).
+ * @return Previous log level.
+ */
+int io_fuzzer_set_log_level(int level);
+
 /**
  * Sets the log handler for the I/O address space fuzzer.
  *
@@ -60,12 +268,12 @@ io_fuzzer_error_handler_t *io_fuzzer_set_error_handler(io_fuzzer_error_handler_t
 io_fuzzer_log_handler_t *io_fuzzer_set_log_handler(io_fuzzer_t *restrict io_fuzzer, io_fuzzer_log_handler_t *handler);
 
 /**
- * Sets the log stream for the I/O address space fuzzer.
+ * Sets the context passed to the log handler of the I/O address space fuzzer.
  *
- * @param [in] stream Log stream.
- * @return Previous log stream.
+ * @param [in] context Log context.
+ * @return Previous log context.
  */
-FILE *io_fuzzer_set_log_stream(io_fuzzer_t *restrict io_fuzzer, FILE *stream);
+void *io_fuzzer_set_log_context(io_fuzzer_t *restrict io_fuzzer, void *context);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,267 @@
+/** @file */
+
+#include "logger.h"
+
+#include "io_fuzzer.h"
+#include "ring.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FLUSH_TIMEOUT_NS 1000000000
+#define IDLE_NS 50000
+
+struct _logger_channel {
+    ring_t *ring;
+    io_fuzzer_log_handler_t *log_handler;
+    void *context;
+    int overflow;
+    _Atomic uint64_t drops;
+};
+
+struct _logger {
+    pthread_t thread;
+    int started;
+    int overflow;
+    logger_channel_t **channels;
+    size_t num_channels;
+    atomic_int stopping;
+    _Atomic uint64_t flush_requested;
+    _Atomic uint64_t flush_completed;
+    logger_flush_handler_t *flush_handler;
+    void *flush_context;
+};
+
+logger_channel_t *
+logger_add_channel(logger_t *restrict logger, size_t num_slots, io_fuzzer_log_handler_t *log_handler, void *context)
+{
+    if (logger->started) {
+        errno = EBUSY;
+        return NULL;
+    }
+
+    logger_channel_t **channels =
+            (logger_channel_t **)realloc(logger->channels, (logger->num_channels + 1) * sizeof(*channels));
+    if (channels == NULL) {
+        return NULL;
+    }
+
+    logger->channels = channels;
+    logger_channel_t *channel = (logger_channel_t *)calloc(1, sizeof(*channel));
+    if (channel == NULL) {
+        return NULL;
+    }
+
+    channel->ring = ring_create(num_slots, sizeof(trace_record_t));
+    if (channel->ring == NULL) {
+        free(channel);
+        return NULL;
+    }
+
+    channel->log_handler = log_handler;
+    channel->context = context;
+    channel->overflow = logger->overflow;
+    atomic_init(&channel->drops, 0);
+    logger->channels[logger->num_channels++] = channel;
+    return channel;
+}
+
+uint64_t
+logger_channel_get_drops(const logger_channel_t *restrict channel)
+{
+    return atomic_load_explicit(&((logger_channel_t *)channel)->drops, memory_order_relaxed);
+}
+
+logger_t *
+logger_create(int overflow)
+{
+    if (overflow < LOGGER_OVERFLOW_BLOCK || overflow > LOGGER_OVERFLOW_DROP_OLDEST) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    logger_t *logger = (logger_t *)calloc(1, sizeof(*logger));
+    if (logger == NULL) {
+        return NULL;
+    }
+
+    logger->overflow = overflow;
+    atomic_init(&logger->stopping, 0);
+    atomic_init(&logger->flush_requested, 0);
+    atomic_init(&logger->flush_completed, 0);
+    return logger;
+}
+
+void
+logger_destroy(logger_t *restrict logger)
+{
+    if (logger == NULL) {
+        return;
+    }
+
+    if (logger->started) {
+        logger_stop(logger);
+    }
+
+    for (size_t i = 0; i < logger->num_channels; ++i) {
+        ring_destroy(logger->channels[i]->ring);
+        free(logger->channels[i]);
+    }
+
+    free(logger->channels);
+    free(logger);
+}
+
+static size_t
+logger_drain(logger_t *restrict logger)
+{
+    size_t num_records = 0;
+    for (size_t i = 0; i < logger->num_channels; ++i) {
+        logger_channel_t *channel = logger->channels[i];
+        const trace_record_t *slot = NULL;
+        while ((slot = (const trace_record_t *)ring_peek(channel->ring)) != NULL) {
+            trace_record_t record;
+            memcpy(&record, slot, sizeof(record));
+            if (ring_consume_checked(channel->ring)) {
+                channel->log_handler(channel->context, &record);
+                ++num_records;
+            }
+        }
+    }
+
+    return num_records;
+}
+
+void
+logger_flush(logger_t *restrict logger)
+{
+    if (logger == NULL || !logger->started || pthread_equal(pthread_self(), logger->thread)) {
+        return;
+    }
+
+    uint64_t request = atomic_fetch_add_explicit(&logger->flush_requested, 1, memory_order_acq_rel) + 1;
+    struct timespec idle = {.tv_sec = 0, .tv_nsec = IDLE_NS};
+    for (long waited = 0; waited < FLUSH_TIMEOUT_NS; waited += IDLE_NS) {
+        if (atomic_load_explicit(&logger->flush_completed, memory_order_acquire) >= request) {
+            return;
+        }
+
+        nanosleep(&idle, NULL);
+    }
+}
+
+void
+logger_log(void *restrict context, const trace_record_t *restrict record)
+{
+    logger_channel_t *channel = (logger_channel_t *)context;
+    void *slot = NULL;
+    switch (channel->overflow) {
+    case LOGGER_OVERFLOW_BLOCK:
+        while ((slot = ring_acquire(channel->ring)) == NULL) {
+            sched_yield();
+        }
+
+        break;
+
+    case LOGGER_OVERFLOW_DROP:
+        slot = ring_acquire(channel->ring);
+        if (slot == NULL) {
+            atomic_fetch_add_explicit(&channel->drops, 1, memory_order_relaxed);
+            return;
+        }
+
+        break;
+
+    case LOGGER_OVERFLOW_DROP_OLDEST: {
+        int dropped = 0;
+        slot = ring_acquire_overwrite(channel->ring, &dropped);
+        if (dropped) {
+            atomic_fetch_add_explicit(&channel->drops, 1, memory_order_relaxed);
+        }
+
+        break;
+    }
+    }
+
+    memcpy(slot, record, sizeof(*record));
+    ring_produce(channel->ring);
+}
+
+static void *
+logger_run(void *arg)
+{
+    logger_t *logger = (logger_t *)arg;
+    struct timespec idle = {.tv_sec = 0, .tv_nsec = IDLE_NS};
+    for (;;) {
+        int stopping = atomic_load_explicit(&logger->stopping, memory_order_acquire);
+        uint64_t request = atomic_load_explicit(&logger->flush_requested, memory_order_acquire);
+        while (logger_drain(logger) != 0) {
+        }
+
+        if (request != atomic_load_explicit(&logger->flush_completed, memory_order_relaxed)
+                && logger->flush_handler != NULL) {
+            logger->flush_handler(logger->flush_context);
+        }
+
+        atomic_store_explicit(&logger->flush_completed, request, memory_order_release);
+        if (stopping) {
+            break;
+        }
+
+        nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+void
+logger_set_flush_handler(logger_t *restrict logger, logger_flush_handler_t *handler, void *context)
+{
+    logger->flush_handler = handler;
+    logger->flush_context = context;
+}
+
+int
+logger_start(logger_t *restrict logger)
+{
+    if (logger->started) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    int error = pthread_create(&logger->thread, NULL, logger_run, logger);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    logger->started = 1;
+    return 0;
+}
+
+int
+logger_stop(logger_t *restrict logger)
+{
+    if (!logger->started) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    atomic_store_explicit(&logger->stopping, 1, memory_order_release);
+    int error = pthread_join(logger->thread, NULL);
+    logger->started = 0;
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/** @file */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "io_fuzzer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Overflow policies of the channels. */
+enum {
+    LOGGER_OVERFLOW_BLOCK,       /**< Wait for the logger thread to free a slot. */
+    LOGGER_OVERFLOW_DROP,        /**< Discard the new record. */
+    LOGGER_OVERFLOW_DROP_OLDEST, /**< Discard the oldest record not yet written. */
+};
+
+/** Logger thread that drains the records of its channels into their log handlers. */
+typedef struct _logger logger_t;
+
+/** Ring of records of a single producer thread. */
+typedef struct _logger_channel logger_channel_t;
+
+typedef void logger_flush_handler_t(void *context);
+
+/**
+ * Adds a channel to the logger. (Channels must be added before the logger is
+ * started.)
+ *
+ * @param [in] logger Logger.
+ * @param [in] num_slots Number of records the channel holds (must be a power
+ *   of two).
+ * @param [in] log_handler Log handler called by the logger thread for each
+ *   record.
+ * @param [in] context Context passed to the log handler.
+ * @return A channel, or NULL and errno is set to indicate the error.
+ */
+logger_channel_t *logger_add_channel(
+        logger_t *restrict logger, size_t num_slots, io_fuzzer_log_handler_t *log_handler, void *context);
+
+/**
+ * Gets the number of records the channel discarded because it was full.
+ *
+ * @param [in] channel Channel.
+ * @return Number of discarded records.
+ */
+uint64_t logger_channel_get_drops(const logger_channel_t *restrict channel);
+
+/**
+ * Creates a logger.
+ *
+ * @param [in] overflow Overflow policy of the channels.
+ * @return A logger, or NULL and errno is set to indicate the error.
+ */
+logger_t *logger_create(int overflow);
+
+/**
+ * Destroys the logger and its channels.
+ *
+ * @param [in] logger Logger.
+ */
+void logger_destroy(logger_t *restrict logger);
+
+/**
+ * Waits, for at most one second, for the logger thread to write all records
+ * published so far and to call the flush handler. (Async-signal-safe; may be
+ * called from a SIGABRT handler.)
+ *
+ * @param [in] logger Logger.
+ */
+void logger_flush(logger_t *restrict logger);
+
+/**
+ * Sets the flush handler of the logger, called by the logger thread after it
+ * writes all records published before a call to logger_flush() (e.g., to write
+ * out the records buffered by the log handlers). (The flush handler must be set
+ * before the logger is started.)
+ *
+ * @param [in] logger Logger.
+ * @param [in] handler Flush handler.
+ * @param [in] context Context passed to the flush handler.
+ */
+void logger_set_flush_handler(logger_t *restrict logger, logger_flush_handler_t *handler, void *context);
+
+/**
+ * Publishes the record to the channel. (Log handler to be set with
+ * io_fuzzer_set_log_handler(); the context is the channel.)
+ *
+ * @param [in] context Channel.
+ * @param [in] record Record.
+ */
+void logger_log(void *restrict context, const trace_record_t *restrict record);
+
+/**
+ * Starts the logger thread.
+ *
+ * @param [in] logger Logger.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int logger_start(logger_t *restrict logger);
+
+/**
+ * Stops the logger thread after it writes all remaining records. (The
+ * producers must have stopped.)
+ *
+ * @param [in] logger Logger.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int logger_stop(logger_t *restrict logger);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOGGER_H */
@@ -0,0 +1,50 @@
+/** @file */
+
+#include "program.h"
+
+#include "io_fuzzer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+void
+program_commit(program_t *restrict program)
+{
+    io_fuzzer_operation_t *operation = &program->operations[program->num_operations++];
+    program->size += ALIGN(io_fuzzer_operation_size(operation));
+}
+
+program_t *
+program_init(void *buf, size_t max_operations, size_t capacity)
+{
+    program_t *program = (program_t *)buf;
+    program->sequence = 0;
+    program->num_operations = 0;
+    program->max_operations = max_operations;
+    program->size = 0;
+    program->capacity = capacity;
+    program->operations = (io_fuzzer_operation_t *)((uint8_t *)buf + ALIGN(sizeof(*program)));
+    program->strings = (uint8_t *)program->operations + ALIGN(max_operations * sizeof(*program->operations));
+    return program;
+}
+
+io_fuzzer_operation_t *
+program_reserve(program_t *restrict program)
+{
+    if (program->num_operations == program->max_operations
+            || program->capacity - program->size < IO_FUZZER_MAX_STRING) {
+        return NULL;
+    }
+
+    io_fuzzer_operation_t *operation = &program->operations[program->num_operations];
+    operation->string = program->strings + program->size;
+    return operation;
+}
+
+size_t
+program_size(size_t max_operations, size_t capacity)
+{
+    return ALIGN(sizeof(program_t)) + ALIGN(max_operations * sizeof(io_fuzzer_operation_t)) + capacity;
+}
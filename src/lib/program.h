@@ -0,0 +1,67 @@
+/** @file */
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "io_fuzzer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Sequence of decoded operations with their strings stored in place. */
+typedef struct _program {
+    uint64_t sequence;                 /**< Sequence number. */
+    size_t num_operations;             /**< Number of operations. */
+    size_t max_operations;             /**< Maximum number of operations. */
+    size_t size;                       /**< Size of the strings, in bytes. */
+    size_t capacity;                   /**< Capacity of the strings, in bytes. */
+    io_fuzzer_operation_t *operations; /**< Operations. */
+    uint8_t *strings;                  /**< Strings of the operations. */
+} program_t;
+
+/**
+ * Appends the operation returned by program_reserve() to the program.
+ *
+ * @param [in] program Program.
+ */
+void program_commit(program_t *restrict program);
+
+/**
+ * Initializes a program in place.
+ *
+ * @param [in] buf Buffer of at least program_size(max_operations, capacity)
+ *   bytes, aligned to 8 bytes.
+ * @param [in] max_operations Maximum number of operations.
+ * @param [in] capacity Capacity of the strings, in bytes.
+ * @return A program.
+ */
+program_t *program_init(void *buf, size_t max_operations, size_t capacity);
+
+/**
+ * Reserves an operation with a string of IO_FUZZER_MAX_STRING bytes at the end
+ * of the program.
+ *
+ * @param [in] program Program.
+ * @return Operation to be decoded and committed, or NULL if the program is
+ *   full.
+ */
+io_fuzzer_operation_t *program_reserve(program_t *restrict program);
+
+/**
+ * Gets the size, in bytes, of a program.
+ *
+ * @param [in] max_operations Maximum number of operations.
+ * @param [in] capacity Capacity of the strings, in bytes.
+ * @return Size, in bytes, of the program.
+ */
+size_t program_size(size_t max_operations, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROGRAM_H */
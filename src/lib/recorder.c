@@ -0,0 +1,183 @@
+/** @file */
+
+#include "recorder.h"
+
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Header of the memory region. */
+typedef struct _recorder_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t num_rings;
+    uint64_t ring_size;
+    uint8_t reserved[32];
+} recorder_header_t;
+
+struct _recorder {
+    void *base;
+    size_t size;
+    recorder_header_t *header;
+};
+
+static recorder_t *
+recorder_map(const char *restrict filename, off_t offset, size_t size, int writable)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    if ((offset % page_size) != 0 || size < sizeof(recorder_header_t)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int fd = open(filename, writable ? O_RDWR : O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    recorder_t *recorder = (recorder_t *)malloc(sizeof(*recorder));
+    if (recorder == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    recorder->size = size;
+    recorder->base = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, offset);
+    close(fd);
+    if (recorder->base == MAP_FAILED) {
+        free(recorder);
+        return NULL;
+    }
+
+    recorder->header = (recorder_header_t *)recorder->base;
+    return recorder;
+}
+
+recorder_t *
+recorder_create(const char *restrict filename, off_t offset, size_t size, size_t num_rings)
+{
+    if (num_rings == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (size < sizeof(recorder_header_t)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t ring_size = ((size - sizeof(recorder_header_t)) / num_rings) & ~(size_t)63;
+    if (ring_size < sizeof(recorder_ring_t) + sizeof(trace_record_t)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    recorder_t *recorder = recorder_map(filename, offset, size, 1);
+    if (recorder == NULL) {
+        return NULL;
+    }
+
+    uint64_t num_slots = (ring_size - sizeof(recorder_ring_t)) / sizeof(trace_record_t);
+    while ((num_slots & (num_slots - 1)) != 0) {
+        num_slots &= num_slots - 1;
+    }
+
+    recorder_header_t *header = recorder->header;
+    memset(header, 0, sizeof(*header));
+    header->version = RECORDER_VERSION;
+    header->record_size = sizeof(trace_record_t);
+    header->num_rings = num_rings;
+    header->ring_size = ring_size;
+    for (size_t i = 0; i < num_rings; ++i) {
+        recorder_ring_t *ring = recorder_get_ring(recorder, i);
+        memset(ring, 0, sizeof(*ring));
+        ring->num_slots = num_slots;
+        atomic_init(&ring->count, 0);
+    }
+
+    /* The magic is written last, so an interrupted initialization is not recovered. */
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, RECORDER_MAGIC, sizeof(header->magic));
+    return recorder;
+}
+
+void
+recorder_destroy(recorder_t *restrict recorder)
+{
+    if (recorder == NULL) {
+        return;
+    }
+
+    munmap(recorder->base, recorder->size);
+    free(recorder);
+}
+
+size_t
+recorder_get_num_rings(const recorder_t *restrict recorder)
+{
+    return recorder->header->num_rings;
+}
+
+recorder_ring_t *
+recorder_get_ring(recorder_t *restrict recorder, size_t ring)
+{
+    return (recorder_ring_t *)((uint8_t *)recorder->base + sizeof(recorder_header_t) +
+                               (ring * recorder->header->ring_size));
+}
+
+recorder_t *
+recorder_open(const char *restrict filename, off_t offset, size_t size)
+{
+    recorder_t *recorder = recorder_map(filename, offset, size, 0);
+    if (recorder == NULL) {
+        return NULL;
+    }
+
+    const recorder_header_t *header = recorder->header;
+    if (memcmp(header->magic, RECORDER_MAGIC, sizeof(header->magic)) != 0 || header->version != RECORDER_VERSION ||
+            header->record_size != sizeof(trace_record_t) || header->num_rings == 0 ||
+            header->ring_size < sizeof(recorder_ring_t) ||
+            header->num_rings > (size - sizeof(*header)) / header->ring_size) {
+        recorder_destroy(recorder);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < header->num_rings; ++i) {
+        const recorder_ring_t *ring = recorder_get_ring(recorder, i);
+        if (ring->num_slots == 0 || (ring->num_slots & (ring->num_slots - 1)) != 0 ||
+                ring->num_slots > (header->ring_size - sizeof(*ring)) / sizeof(trace_record_t)) {
+            recorder_destroy(recorder);
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    return recorder;
+}
+
+uint64_t
+recorder_print_json(recorder_t *restrict recorder, size_t ring, FILE *restrict stream)
+{
+    recorder_ring_t *recorder_ring = recorder_get_ring(recorder, ring);
+    uint64_t count = atomic_load_explicit(&recorder_ring->count, memory_order_acquire);
+    uint64_t first = (count >= recorder_ring->num_slots) ? (count - recorder_ring->num_slots + 1) : 0;
+    for (uint64_t i = first; i < count; ++i) {
+        trace_record_print_json(
+                stream, &recorder_ring->header, &recorder_ring->records[i & (recorder_ring->num_slots - 1)]);
+    }
+
+    return count - first;
+}
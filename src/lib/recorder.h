@@ -0,0 +1,113 @@
+/** @file */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/types.h>
+
+#define RECORDER_MAGIC "IOFZFLR"
+#define RECORDER_VERSION 1
+
+/** Ring of the last records of a worker in the flight recorder. */
+typedef struct _recorder_ring {
+    trace_header_t header;    /**< Trace file header of the worker. */
+    uint64_t num_slots;       /**< Number of records (a power of two). */
+    _Atomic uint64_t count;   /**< Number of records written. */
+    uint8_t reserved[16];     /**< Reserved. */
+    trace_record_t records[]; /**< Records. */
+} recorder_ring_t;
+
+/** Flight recorder of the last records of each worker in persistent memory. */
+typedef struct _recorder recorder_t;
+
+/**
+ * Creates a flight recorder, initializing the memory region.
+ *
+ * @param [in] filename Name of the file the memory region is mapped from
+ *   (e.g., /dev/mem).
+ * @param [in] offset Offset of the memory region (i.e., its physical address
+ *   for /dev/mem), aligned to the page size.
+ * @param [in] size Size of the memory region, in bytes.
+ * @param [in] num_rings Number of rings (i.e., workers).
+ * @return A flight recorder, or NULL and errno is set to indicate the error.
+ */
+recorder_t *recorder_create(const char *restrict filename, off_t offset, size_t size, size_t num_rings);
+
+/**
+ * Destroys the flight recorder. (The memory region is left intact.)
+ *
+ * @param [in] recorder Flight recorder.
+ */
+void recorder_destroy(recorder_t *restrict recorder);
+
+/**
+ * Gets the number of rings of the flight recorder.
+ *
+ * @param [in] recorder Flight recorder.
+ * @return Number of rings.
+ */
+size_t recorder_get_num_rings(const recorder_t *restrict recorder);
+
+/**
+ * Gets a ring of the flight recorder.
+ *
+ * @param [in] recorder Flight recorder.
+ * @param [in] ring Ring number.
+ * @return Ring.
+ */
+recorder_ring_t *recorder_get_ring(recorder_t *restrict recorder, size_t ring);
+
+/**
+ * Opens an existing flight recorder for recovery.
+ *
+ * @param [in] filename Name of the file the memory region is mapped from.
+ * @param [in] offset Offset of the memory region, aligned to the page size.
+ * @param [in] size Size of the memory region, in bytes.
+ * @return A flight recorder, or NULL and errno is set to indicate the error
+ *   (EINVAL if the memory region does not contain a flight recorder).
+ */
+recorder_t *recorder_open(const char *restrict filename, off_t offset, size_t size);
+
+/**
+ * Prints the records that survived in the ring as JSON lines, oldest first.
+ * (The oldest slot is skipped once the ring wraps around, since it may have
+ * been partially overwritten.)
+ *
+ * @param [in] recorder Flight recorder.
+ * @param [in] ring Ring number.
+ * @param [in] stream Stream.
+ * @return Number of records printed.
+ */
+uint64_t recorder_print_json(recorder_t *restrict recorder, size_t ring, FILE *restrict stream);
+
+/**
+ * Writes the record to the ring. (Only the worker of the ring may write to
+ * it.)
+ *
+ * @param [in] ring Ring.
+ * @param [in] record Record.
+ */
+static inline void
+recorder_write(recorder_ring_t *restrict ring, const trace_record_t *restrict record)
+{
+    uint64_t count = atomic_load_explicit(&ring->count, memory_order_relaxed);
+    ring->records[count & (ring->num_slots - 1)] = *record;
+    atomic_store_explicit(&ring->count, count + 1, memory_order_release);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORDER_H */
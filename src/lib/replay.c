@@ -0,0 +1,199 @@
+/** @file */
+
+#include "replay.h"
+
+#include "blob.h"
+#include "io_fuzzer.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct _replay {
+    io_fuzzer_operation_t *operations;
+    uint64_t *times;
+    size_t num_operations;
+    size_t capacity;
+    size_t times_capacity;
+    uint8_t *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+    uint8_t *buffer;
+    uint64_t num_missing;
+};
+
+static int
+replay_reserve(void **ptr, size_t *capacity, size_t size, size_t element_size)
+{
+    if (size <= *capacity) {
+        return 0;
+    }
+
+    size_t new_capacity = (*capacity == 0) ? 64 : *capacity;
+    while (new_capacity < size) {
+        new_capacity *= 2;
+    }
+
+    void *new_ptr = realloc(*ptr, new_capacity * element_size);
+    if (new_ptr == NULL) {
+        return -1;
+    }
+
+    *ptr = new_ptr;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static int
+replay_add(replay_t *restrict replay, const trace_header_t *restrict header, const trace_record_t *restrict record,
+        blob_store_t *blob_store)
+{
+    size_t num_operations = replay->num_operations + 1;
+    if (replay_reserve((void **)&replay->operations, &replay->capacity, num_operations, sizeof(*replay->operations))
+                    == -1
+            || replay_reserve((void **)&replay->times, &replay->times_capacity, num_operations, sizeof(*replay->times))
+                    == -1) {
+        return -1;
+    }
+
+    io_fuzzer_operation_t *operation = &replay->operations[replay->num_operations];
+    operation->function = record->function;
+    operation->port = record->port;
+    operation->count = record->count;
+    operation->value = record->value;
+    operation->string = NULL;
+    size_t size = io_fuzzer_operation_size(operation);
+    if (size > IO_FUZZER_MAX_STRING) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (record->function) {
+    case IO_FUZZER_IO_READ_STRING16:
+    case IO_FUZZER_IO_READ_STRING32:
+    case IO_FUZZER_IO_READ_STRING8:
+        operation->string = replay->buffer;
+        break;
+
+    case IO_FUZZER_IO_WRITE_STRING16:
+    case IO_FUZZER_IO_WRITE_STRING32:
+    case IO_FUZZER_IO_WRITE_STRING8: {
+        if (size == 0) {
+            operation->string = replay->buffer;
+            break;
+        }
+
+        if (replay_reserve((void **)&replay->strings, &replay->strings_capacity, replay->strings_size + size, 1)
+                == -1) {
+            return -1;
+        }
+
+        /* The strings may still be moved; the offset is replaced by the address once they are all loaded. */
+        uint8_t *string = replay->strings + replay->strings_size;
+        operation->string = (void *)(uintptr_t)replay->strings_size;
+        replay->strings_size += size;
+        if (blob_store == NULL || (header->flags & TRACE_FLAG_PAYLOAD_HASH) == 0
+                || blob_store_get(blob_store, record->payload, string, size) != (ssize_t)size) {
+            memset(string, 0, size);
+            ++replay->num_missing;
+        }
+
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    replay->times[replay->num_operations++] = record->time;
+    return 0;
+}
+
+replay_t *
+replay_create(trace_reader_t *restrict reader, blob_store_t *blob_store, uint64_t first, uint64_t last)
+{
+    replay_t *replay = (replay_t *)calloc(1, sizeof(*replay));
+    if (replay == NULL) {
+        return NULL;
+    }
+
+    replay->buffer = (uint8_t *)malloc(IO_FUZZER_MAX_STRING);
+    if (replay->buffer == NULL) {
+        replay_destroy(replay);
+        return NULL;
+    }
+
+    const trace_header_t *header = trace_reader_get_header(reader);
+    trace_record_t record;
+    int result = 0;
+    for (uint64_t index = 0; index <= last && (result = trace_reader_read(reader, &record)) == 1;) {
+        if (record.function >= IO_FUZZER_NUM_FUNCTIONS) {
+            continue;
+        }
+
+        if (index++ >= first && replay_add(replay, header, &record, blob_store) == -1) {
+            replay_destroy(replay);
+            return NULL;
+        }
+    }
+
+    if (result == -1) {
+        replay_destroy(replay);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < replay->num_operations; ++i) {
+        io_fuzzer_operation_t *operation = &replay->operations[i];
+        switch (operation->function) {
+        case IO_FUZZER_IO_WRITE_STRING16:
+        case IO_FUZZER_IO_WRITE_STRING32:
+        case IO_FUZZER_IO_WRITE_STRING8:
+            if (operation->count != 0) {
+                operation->string = replay->strings + (uintptr_t)operation->string;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return replay;
+}
+
+void
+replay_destroy(replay_t *restrict replay)
+{
+    if (replay == NULL) {
+        return;
+    }
+
+    free(replay->buffer);
+    free(replay->strings);
+    free(replay->times);
+    free(replay->operations);
+    free(replay);
+}
+
+uint64_t
+replay_get_num_missing(const replay_t *restrict replay)
+{
+    return replay->num_missing;
+}
+
+const io_fuzzer_operation_t *
+replay_get_operations(const replay_t *restrict replay, size_t *num_operations)
+{
+    *num_operations = replay->num_operations;
+    return replay->operations;
+}
+
+const uint64_t *
+replay_get_times(const replay_t *restrict replay)
+{
+    return replay->times;
+}
@@ -0,0 +1,75 @@
+/** @file */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "blob.h"
+#include "io_fuzzer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Operations of a trace loaded into memory to be performed again, with the
+ * strings written, so that replaying them does not read or parse the trace.
+ */
+typedef struct _replay replay_t;
+
+/**
+ * Loads the operations of a trace, skipping the other records (e.g., programs
+ * and responses). The strings written are read from the blob store if the
+ * trace has their hashes; otherwise (or if they are not in the store), they
+ * are replayed as zeros.
+ *
+ * @param [in] reader Trace reader.
+ * @param [in] blob_store Blob store, or NULL.
+ * @param [in] first Index of the first operation loaded.
+ * @param [in] last Index of the last operation loaded.
+ * @return A replay, or NULL and errno is set to indicate the error.
+ */
+replay_t *replay_create(trace_reader_t *restrict reader, blob_store_t *blob_store, uint64_t first, uint64_t last);
+
+/**
+ * Destroys the replay.
+ *
+ * @param [in] replay Replay.
+ */
+void replay_destroy(replay_t *restrict replay);
+
+/**
+ * Gets the number of string writes whose strings are not available (and are
+ * replayed as zeros).
+ *
+ * @param [in] replay Replay.
+ * @return Number of string writes without strings.
+ */
+uint64_t replay_get_num_missing(const replay_t *restrict replay);
+
+/**
+ * Gets the operations of the replay. (String reads share a single buffer.)
+ *
+ * @param [in] replay Replay.
+ * @param [out] num_operations Number of operations.
+ * @return Operations.
+ */
+const io_fuzzer_operation_t *replay_get_operations(const replay_t *restrict replay, size_t *num_operations);
+
+/**
+ * Gets the times the operations of the replay were logged (i.e., right before
+ * they were performed), in nanoseconds since the epoch.
+ *
+ * @param [in] replay Replay.
+ * @return Times of the operations.
+ */
+const uint64_t *replay_get_times(const replay_t *restrict replay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H */
@@ -0,0 +1,52 @@
+/** @file */
+
+#include "ring.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SLOT_ALIGNMENT 64
+
+ring_t *
+ring_create(size_t num_slots, size_t slot_size)
+{
+    if (num_slots == 0 || (num_slots & (num_slots - 1)) != 0 || slot_size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ring_t *ring = (ring_t *)aligned_alloc(_Alignof(ring_t), sizeof(*ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    slot_size = (slot_size + (SLOT_ALIGNMENT - 1)) & ~(size_t)(SLOT_ALIGNMENT - 1);
+    ring->slots = (uint8_t *)aligned_alloc(SLOT_ALIGNMENT, num_slots * slot_size);
+    if (ring->slots == NULL) {
+        free(ring);
+        return NULL;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->tail_cache = 0;
+    ring->head_peek = 0;
+    ring->head_cache = 0;
+    ring->num_slots = num_slots;
+    ring->slot_size = slot_size;
+    return ring;
+}
+
+void
+ring_destroy(ring_t *restrict ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+
+    free(ring->slots);
+    free(ring);
+}
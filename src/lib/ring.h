@@ -0,0 +1,156 @@
+/** @file */
+
+#ifndef RING_H
+#define RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Lock-free single-producer, single-consumer ring of fixed-size slots. */
+typedef struct _ring {
+    _Alignas(64) atomic_size_t head; /**< Index of the next slot to be consumed. */
+    size_t tail_cache;               /**< Consumer's copy of the tail. */
+    size_t head_peek;                /**< Head returned by the last peek. */
+    _Alignas(64) atomic_size_t tail; /**< Index of the next slot to be produced. */
+    size_t head_cache;               /**< Producer's copy of the head. */
+    _Alignas(64) size_t num_slots;   /**< Number of slots (a power of two). */
+    size_t slot_size;                /**< Size of each slot, in bytes. */
+    uint8_t *slots;                  /**< Slots. */
+} ring_t;
+
+/**
+ * Gets the next free slot of the ring. (Producer only.)
+ *
+ * @param [in] ring Ring.
+ * @return Next free slot, or NULL if the ring is full.
+ */
+static inline void *
+ring_acquire(ring_t *restrict ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - ring->head_cache == ring->num_slots) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->head_cache == ring->num_slots) {
+            return NULL;
+        }
+    }
+
+    return ring->slots + ((tail & (ring->num_slots - 1)) * ring->slot_size);
+}
+
+/**
+ * Gets the next free slot of the ring, discarding the oldest published slot if
+ * the ring is full. (Producer only; the consumer must use
+ * ring_consume_checked().)
+ *
+ * @param [in] ring Ring.
+ * @param [out] dropped Whether the oldest published slot was discarded.
+ * @return Next free slot.
+ */
+static inline void *
+ring_acquire_overwrite(ring_t *restrict ring, int *dropped)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    *dropped = 0;
+    if (tail - ring->head_cache == ring->num_slots) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (tail - ring->head_cache == ring->num_slots) {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &ring->head_cache, ring->head_cache + 1,
+                        memory_order_acq_rel, memory_order_acquire)) {
+                ++ring->head_cache;
+                *dropped = 1;
+            }
+        }
+    }
+
+    return ring->slots + ((tail & (ring->num_slots - 1)) * ring->slot_size);
+}
+
+/**
+ * Publishes the slot returned by ring_acquire() to the consumer. (Producer
+ * only.)
+ *
+ * @param [in] ring Ring.
+ */
+static inline void
+ring_produce(ring_t *restrict ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Gets the next published slot of the ring. (Consumer only.)
+ *
+ * @param [in] ring Ring.
+ * @return Next published slot, or NULL if the ring is empty.
+ */
+static inline void *
+ring_peek(ring_t *restrict ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->tail_cache) {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->tail_cache) {
+            return NULL;
+        }
+    }
+
+    ring->head_peek = head;
+    return ring->slots + ((head & (ring->num_slots - 1)) * ring->slot_size);
+}
+
+/**
+ * Releases the slot returned by ring_peek() to the producer. (Consumer only.)
+ *
+ * @param [in] ring Ring.
+ */
+static inline void
+ring_consume(ring_t *restrict ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * Releases the slot returned by ring_peek() to the producer, unless the
+ * producer discarded it with ring_acquire_overwrite() in the meantime, in which
+ * case any data copied from the slot must be discarded. (Consumer only.)
+ *
+ * @param [in] ring Ring.
+ * @return 1 if the slot was released; otherwise, 0 if it was discarded.
+ */
+static inline int
+ring_consume_checked(ring_t *restrict ring)
+{
+    size_t expected = ring->head_peek;
+    return atomic_compare_exchange_strong_explicit(
+            &ring->head, &expected, ring->head_peek + 1, memory_order_acq_rel, memory_order_relaxed);
+}
+
+/**
+ * Creates a ring.
+ *
+ * @param [in] num_slots Number of slots (must be a power of two).
+ * @param [in] slot_size Size of each slot, in bytes.
+ * @return A ring, or NULL and errno is set to indicate the error.
+ */
+ring_t *ring_create(size_t num_slots, size_t slot_size);
+
+/**
+ * Destroys the ring.
+ *
+ * @param [in] ring Ring.
+ */
+void ring_destroy(ring_t *restrict ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RING_H */
@@ -0,0 +1,285 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "segment.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE (64 * 1024)
+#define ALIGN(size) (((size) + SEGMENT_ALIGNMENT - 1) & ~(uint64_t)(SEGMENT_ALIGNMENT - 1))
+
+struct _segment_writer {
+    char *prefix;
+    uint64_t segment_size;
+    size_t max_segments;
+    void *preamble;
+    size_t preamble_size;
+    int fd;
+    uint64_t number;
+    uint64_t num_segments;
+    off_t offset;
+    size_t used;
+    uint8_t *buffer;
+};
+
+static int
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+    const uint8_t *ptr = (const uint8_t *)buf;
+    while (count > 0) {
+        ssize_t result = pwrite(fd, ptr, count, offset);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        ptr += result;
+        count -= result;
+        offset += result;
+    }
+
+    return 0;
+}
+
+static void
+segment_filename(const segment_writer_t *restrict writer, uint64_t number, char *filename, size_t size)
+{
+    snprintf(filename, size, "%s.%06llu", writer->prefix, (unsigned long long)number);
+}
+
+static int
+segment_writer_append(segment_writer_t *restrict writer, const void *data, size_t size)
+{
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        size_t count = BUFFER_SIZE - writer->used;
+        if (count > size) {
+            count = size;
+        }
+
+        memcpy(writer->buffer + writer->used, ptr, count);
+        writer->used += count;
+        ptr += count;
+        size -= count;
+        if (writer->used == BUFFER_SIZE) {
+            if (pwrite_all(writer->fd, writer->buffer, BUFFER_SIZE, writer->offset) == -1) {
+                return -1;
+            }
+
+            writer->offset += BUFFER_SIZE;
+            writer->used = 0;
+        }
+    }
+
+    return 0;
+}
+
+static int
+segment_writer_close(segment_writer_t *restrict writer)
+{
+    if (writer->fd == -1) {
+        return 0;
+    }
+
+    int result = 0;
+    if (segment_writer_flush(writer) == -1 || ftruncate(writer->fd, writer->offset + writer->used) == -1
+            || fdatasync(writer->fd) == -1) {
+        result = -1;
+    }
+
+    close(writer->fd);
+    writer->fd = -1;
+    return result;
+}
+
+static int
+segment_writer_find_next(segment_writer_t *restrict writer)
+{
+    char dirname[PATH_MAX];
+    snprintf(dirname, sizeof(dirname), "%s", writer->prefix);
+    const char *basename = writer->prefix;
+    char *slash = strrchr(dirname, '/');
+    if (slash != NULL) {
+        basename += slash - dirname + 1;
+        slash[(slash == dirname) ? 1 : 0] = '\0';
+    } else {
+        strcpy(dirname, ".");
+    }
+
+    DIR *dir = opendir(dirname);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    /* Numbering continues after the last existing segment, as the oldest ones may have been removed. */
+    size_t length = strlen(basename);
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (strncmp(name, basename, length) != 0 || name[length] != '.' || !isdigit((unsigned char)name[length + 1])) {
+            continue;
+        }
+
+        char *end = NULL;
+        unsigned long long number = strtoull(name + length + 1, &end, 10);
+        if (*end == '\0' && number >= writer->number) {
+            writer->number = number + 1;
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+static int
+segment_writer_open(segment_writer_t *restrict writer)
+{
+    char filename[PATH_MAX];
+    segment_filename(writer, writer->number, filename, sizeof(filename));
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (writer->fd == -1) {
+        return -1;
+    }
+
+    /*
+     * O_DIRECT is set once the file exists, since open() would create the file
+     * before rejecting it on file systems that do not support it (e.g., tmpfs).
+     */
+    int flags = fcntl(writer->fd, F_GETFL);
+    if (flags == -1 || (fcntl(writer->fd, F_SETFL, flags | O_DIRECT) == -1 && errno != EINVAL)) {
+        close(writer->fd);
+        writer->fd = -1;
+        return -1;
+    }
+
+#ifdef HAVE_FALLOCATE
+    if (fallocate(writer->fd, 0, 0, writer->segment_size) == -1 && errno != EOPNOTSUPP) {
+        close(writer->fd);
+        writer->fd = -1;
+        return -1;
+    }
+#endif
+
+    if (writer->max_segments != 0 && writer->number >= writer->max_segments) {
+        segment_filename(writer, writer->number - writer->max_segments, filename, sizeof(filename));
+        unlink(filename);
+    }
+
+    ++writer->num_segments;
+    writer->offset = 0;
+    writer->used = 0;
+    return segment_writer_append(writer, writer->preamble, writer->preamble_size);
+}
+
+segment_writer_t *
+segment_writer_create(const char *prefix, uint64_t segment_size, size_t max_segments, const void *preamble,
+        size_t preamble_size)
+{
+    if (segment_size == 0 || segment_size % SEGMENT_ALIGNMENT != 0 || preamble_size >= segment_size) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    segment_writer_t *writer = (segment_writer_t *)calloc(1, sizeof(*writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+
+    writer->fd = -1;
+    writer->segment_size = segment_size;
+    writer->max_segments = max_segments;
+    writer->preamble_size = preamble_size;
+    writer->prefix = strdup(prefix);
+    writer->preamble = malloc(preamble_size + 1);
+    writer->buffer = (uint8_t *)aligned_alloc(SEGMENT_ALIGNMENT, BUFFER_SIZE);
+    if (writer->prefix == NULL || writer->preamble == NULL || writer->buffer == NULL) {
+        segment_writer_destroy(writer);
+        return NULL;
+    }
+
+    memcpy(writer->preamble, preamble, preamble_size);
+    if (segment_writer_find_next(writer) == -1 || segment_writer_open(writer) == -1) {
+        segment_writer_destroy(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+void
+segment_writer_destroy(segment_writer_t *restrict writer)
+{
+    if (writer == NULL) {
+        return;
+    }
+
+    segment_writer_close(writer);
+    free(writer->buffer);
+    free(writer->preamble);
+    free(writer->prefix);
+    free(writer);
+}
+
+int
+segment_writer_flush(segment_writer_t *restrict writer)
+{
+    if (writer->used == 0) {
+        return 0;
+    }
+
+    size_t size = ALIGN(writer->used);
+    memset(writer->buffer + writer->used, 0, size - writer->used);
+    return pwrite_all(writer->fd, writer->buffer, size, writer->offset);
+}
+
+int
+segment_writer_get_fd(const segment_writer_t *restrict writer)
+{
+    return writer->fd;
+}
+
+uint64_t
+segment_writer_get_num_segments(const segment_writer_t *restrict writer)
+{
+    return writer->num_segments;
+}
+
+int
+segment_writer_write(segment_writer_t *restrict writer, const void *data, size_t size)
+{
+    if (size > writer->segment_size - writer->preamble_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (writer->offset + writer->used + size > writer->segment_size) {
+        if (segment_writer_close(writer) == -1) {
+            return -1;
+        }
+
+        ++writer->number;
+        if (segment_writer_open(writer) == -1) {
+            return -1;
+        }
+    }
+
+    return segment_writer_append(writer, data, size);
+}
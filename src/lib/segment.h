@@ -0,0 +1,89 @@
+/** @file */
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEGMENT_ALIGNMENT 4096 /**< Alignment of the writes, in bytes. */
+
+/**
+ * Writer of a log as a sequence of fixed-size, preallocated segment files
+ * (i.e., the prefix suffixed with the segment number), written in aligned
+ * blocks with O_DIRECT.
+ */
+typedef struct _segment_writer segment_writer_t;
+
+/**
+ * Creates a segment writer and its first segment, numbered after the last
+ * existing segment of the prefix. Each segment begins with the preamble (e.g.,
+ * the trace file header), and is truncated to the size of its data when the
+ * writer rotates to the next one or is destroyed.
+ *
+ * @param [in] prefix File name prefix of the segments.
+ * @param [in] segment_size Size of each segment, in bytes (a multiple of
+ *   SEGMENT_ALIGNMENT).
+ * @param [in] max_segments Maximum number of segments kept, older segments
+ *   being removed (0 for no limit).
+ * @param [in] preamble Data written at the beginning of each segment.
+ * @param [in] preamble_size Size of the preamble, in bytes.
+ * @return A segment writer, or NULL and errno is set to indicate the error.
+ */
+segment_writer_t *segment_writer_create(const char *prefix, uint64_t segment_size, size_t max_segments,
+        const void *preamble, size_t preamble_size);
+
+/**
+ * Destroys the segment writer, writing its buffered data and truncating the
+ * current segment to the size of its data.
+ *
+ * @param [in] writer Segment writer.
+ */
+void segment_writer_destroy(segment_writer_t *restrict writer);
+
+/**
+ * Writes the buffered data to the current segment (padding the last block
+ * with zeros, which is rewritten once it has more data).
+ *
+ * @param [in] writer Segment writer.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int segment_writer_flush(segment_writer_t *restrict writer);
+
+/**
+ * Gets the file descriptor of the current segment.
+ *
+ * @param [in] writer Segment writer.
+ * @return File descriptor of the current segment.
+ */
+int segment_writer_get_fd(const segment_writer_t *restrict writer);
+
+/**
+ * Gets the number of segments created by the segment writer.
+ *
+ * @param [in] writer Segment writer.
+ * @return Number of segments created.
+ */
+uint64_t segment_writer_get_num_segments(const segment_writer_t *restrict writer);
+
+/**
+ * Appends data to the buffer of the segment writer, writing each block once it
+ * is full, and rotating to the next segment if the data does not fit in the
+ * current one. (The data of a single call is never split across segments.)
+ *
+ * @param [in] writer Segment writer.
+ * @param [in] data Data.
+ * @param [in] size Size of the data, in bytes.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int segment_writer_write(segment_writer_t *restrict writer, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEGMENT_H */
@@ -0,0 +1,634 @@
+/** @file */
+
+#include "trace.h"
+
+#include "io_fuzzer.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#define BUFFER_SIZE (64 * 1024)
+#define MAX_LINE 1024
+#define MAX_RECORD_SIZE 256
+
+struct _trace_reader {
+    FILE *stream;
+    int json;
+    trace_header_t header;
+    uint64_t line;
+    uint64_t num_records;
+    char buffer[MAX_LINE];
+};
+
+struct _trace_writer {
+    int fd;
+    size_t size;
+    uint8_t buffer[BUFFER_SIZE];
+};
+
+static int
+write_all(int fd, const void *buf, size_t count)
+{
+    const uint8_t *ptr = (const uint8_t *)buf;
+    while (count > 0) {
+        ssize_t result = write(fd, ptr, count);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        ptr += result;
+        count -= result;
+    }
+
+    return 0;
+}
+
+static inline char *
+json_skip_space(char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        ++p;
+    }
+
+    return p;
+}
+
+static char *
+json_scan_number(char *p, uint64_t *value)
+{
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    *value = 0;
+    for (; *p >= '0' && *p <= '9'; ++p) {
+        uint64_t digit = *p - '0';
+        if (*value > (UINT64_MAX - digit) / 10) {
+            return NULL;
+        }
+
+        *value = *value * 10 + digit;
+    }
+
+    return p;
+}
+
+static char *
+json_scan_string(char *p, char **value)
+{
+    if (*p != '"') {
+        return NULL;
+    }
+
+    *value = ++p;
+    for (; *p != '"'; ++p) {
+        if (*p == '\0' || *p == '\\') {
+            return NULL;
+        }
+    }
+
+    *p = '\0';
+    return p + 1;
+}
+
+static int
+json_parse_hex(const char *str, uint64_t *value)
+{
+    if (*str == '\0') {
+        return -1;
+    }
+
+    *value = 0;
+    for (; *str != '\0'; ++str) {
+        int digit = (*str >= '0' && *str <= '9') ? (*str - '0')
+                : (*str >= 'a' && *str <= 'f')   ? (*str - 'a' + 10)
+                : (*str >= 'A' && *str <= 'F')   ? (*str - 'A' + 10)
+                                                 : -1;
+        if (digit == -1 || (*value >> 60) != 0) {
+            return -1;
+        }
+
+        *value = (*value << 4) | digit;
+    }
+
+    return 0;
+}
+
+int
+trace_function_from_name(const char *name)
+{
+    if (strcmp(name, "program") == 0) {
+        return TRACE_FUNCTION_PROGRAM;
+    }
+
+    if (strcmp(name, "race") == 0) {
+        return TRACE_FUNCTION_RACE;
+    }
+
+    if (strcmp(name, "response") == 0) {
+        return TRACE_FUNCTION_RESPONSE;
+    }
+
+    if (strcmp(name, "response_string") == 0) {
+        return TRACE_FUNCTION_RESPONSE_STRING;
+    }
+
+    if (strcmp(name, "execute") == 0) {
+        return TRACE_FUNCTION_EXECUTE;
+    }
+
+    for (int function = 0; function < IO_FUZZER_NUM_FUNCTIONS; ++function) {
+        if (strcmp(name, io_fuzzer_function_name(function)) == 0) {
+            return function;
+        }
+    }
+
+    return -1;
+}
+
+void
+trace_header_init(trace_header_t *restrict header, uint32_t worker, uint64_t seed)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(trace_record_t);
+    header->worker = worker;
+    header->seed = seed;
+}
+
+int
+trace_read_header(FILE *restrict stream, trace_header_t *restrict header)
+{
+    if (fread(header, sizeof(*header), 1, stream) < 1) {
+        if (!ferror(stream)) {
+            errno = EINVAL;
+        }
+
+        return -1;
+    }
+
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 || header->version == 0
+            || header->version > TRACE_VERSION || header->record_size == 0 || header->record_size > MAX_RECORD_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+trace_read_record(FILE *restrict stream, const trace_header_t *restrict header, trace_record_t *restrict record)
+{
+    uint8_t buf[MAX_RECORD_SIZE];
+    size_t size = fread(buf, 1, header->record_size, stream);
+    if (size < header->record_size) {
+        if (ferror(stream)) {
+            return -1;
+        }
+
+        if (size > 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    static const uint8_t zero[MAX_RECORD_SIZE];
+    if (memcmp(buf, zero, header->record_size) == 0) {
+        /* Preallocated tail of a segment that was not closed. */
+        return 0;
+    }
+
+    memset(record, 0, sizeof(*record));
+    memcpy(record, buf, (size < sizeof(*record)) ? size : sizeof(*record));
+    return 1;
+}
+
+trace_reader_t *
+trace_reader_create(FILE *restrict stream)
+{
+    trace_reader_t *reader = (trace_reader_t *)calloc(1, sizeof(*reader));
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    reader->stream = stream;
+    int c = getc(stream);
+    if (c == EOF && ferror(stream)) {
+        free(reader);
+        return NULL;
+    }
+
+    if (c != EOF) {
+        ungetc(c, stream);
+    }
+
+    if (c == TRACE_MAGIC[0]) {
+        if (trace_read_header(stream, &reader->header) == -1) {
+            free(reader);
+            return NULL;
+        }
+
+        return reader;
+    }
+
+    reader->json = 1;
+    trace_header_init(&reader->header, 0, 0);
+    return reader;
+}
+
+void
+trace_reader_destroy(trace_reader_t *restrict reader)
+{
+    free(reader);
+}
+
+const trace_header_t *
+trace_reader_get_header(const trace_reader_t *restrict reader)
+{
+    return &reader->header;
+}
+
+uint64_t
+trace_reader_get_line(const trace_reader_t *restrict reader)
+{
+    return reader->json ? reader->line : reader->num_records;
+}
+
+int
+trace_reader_is_json(const trace_reader_t *restrict reader)
+{
+    return reader->json;
+}
+
+int
+trace_reader_read(trace_reader_t *restrict reader, trace_record_t *restrict record)
+{
+    if (!reader->json) {
+        int result = trace_read_record(reader->stream, &reader->header, record);
+        reader->num_records += (result == 1);
+        return result;
+    }
+
+    for (;;) {
+        if (fgets(reader->buffer, sizeof(reader->buffer), reader->stream) == NULL) {
+            return ferror(reader->stream) ? -1 : 0;
+        }
+
+        ++reader->line;
+        size_t length = strlen(reader->buffer);
+        if (length == sizeof(reader->buffer) - 1 && reader->buffer[length - 1] != '\n' && !feof(reader->stream)) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        if (*json_skip_space(reader->buffer) != '\0') {
+            break;
+        }
+    }
+
+    if (trace_record_parse_json(reader->buffer, record, &reader->header.flags) == -1) {
+        return -1;
+    }
+
+    record->sequence = reader->num_records++;
+    return 1;
+}
+
+int
+trace_record_parse_json(char *restrict line, trace_record_t *restrict record, uint32_t *restrict flags)
+{
+    memset(record, 0, sizeof(*record));
+    int function = -1;
+    int has_width = 0;
+    int has_value = 0;
+    char *p = json_skip_space(line);
+    if (*p++ != '{') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (p = json_skip_space(p); *p != '}';) {
+        char *key = NULL;
+        char *str = NULL;
+        uint64_t number = 0;
+        if ((p = json_scan_string(p, &key)) == NULL || *(p = json_skip_space(p)) != ':') {
+            errno = EINVAL;
+            return -1;
+        }
+
+        p = json_skip_space(p + 1);
+        p = (*p == '"') ? json_scan_string(p, &str) : json_scan_number(p, &number);
+        if (p == NULL) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        int valid = 1;
+        if (strcmp(key, "function") == 0) {
+            function = (str != NULL) ? trace_function_from_name(str) : ((number <= UINT8_MAX) ? (int)number : -1);
+            valid = (function != -1);
+        } else if (strcmp(key, "port") == 0) {
+            record->port = number;
+            valid = (str == NULL && number <= UINT16_MAX);
+        } else if (strcmp(key, "value") == 0) {
+            record->value = number;
+            has_value = 1;
+            valid = (str == NULL && number <= UINT32_MAX);
+        } else if (strcmp(key, "skew") == 0 || strcmp(key, "generator") == 0) {
+            record->value = number;
+            valid = (str == NULL && number <= UINT32_MAX);
+        } else if (strcmp(key, "count") == 0) {
+            record->count = number;
+            valid = (str == NULL && number <= UINT32_MAX);
+        } else if (strcmp(key, "width") == 0) {
+            record->width = number;
+            has_width = 1;
+            valid = (str == NULL && number <= UINT8_MAX);
+        } else if (strcmp(key, "string") == 0 || strcmp(key, "sequence") == 0 || strcmp(key, "round") == 0) {
+            record->payload = number;
+            valid = (str == NULL);
+        } else if (strcmp(key, "hash") == 0) {
+            valid = (str != NULL && json_parse_hex(str, &record->payload) == 0);
+            *flags |= TRACE_FLAG_PAYLOAD_HASH;
+        } else if (strcmp(key, "crc32c") == 0) {
+            valid = (str != NULL && json_parse_hex(str, &number) == 0 && number <= UINT32_MAX);
+            record->value = number;
+        } else if (strcmp(key, "time_ns") == 0) {
+            record->time = number;
+            valid = (str == NULL);
+        } else if (strcmp(key, "previous_latency") == 0) {
+            record->latency = number;
+            valid = (str == NULL && number <= UINT32_MAX);
+        }
+
+        if (!valid) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        p = json_skip_space(p);
+        if (*p == ',') {
+            p = json_skip_space(p + 1);
+        } else if (*p != '}') {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (function == -1 || *json_skip_space(p + 1) != '\0') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    record->function = function;
+    if (!has_width) {
+        record->width = io_fuzzer_function_width(function);
+    }
+
+    /* Values of I/O operations and responses fit in their width. */
+    if (has_value && record->width >= 1 && record->width <= 4
+            && record->value > (UINT32_MAX >> (32 - (8 * record->width)))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+trace_format(char *restrict buf, size_t size, int *restrict length, const char *restrict format, ...)
+{
+    if (*length < 0) {
+        return;
+    }
+
+    size_t offset = ((size_t)*length < size) ? (size_t)*length : size;
+    va_list ap;
+    va_start(ap, format);
+    int result = vsnprintf(buf + offset, size - offset, format, ap);
+    va_end(ap);
+    *length = (result < 0) ? -1 : *length + result;
+}
+
+static int
+trace_record_format(char *restrict buf, size_t size, const trace_header_t *restrict header,
+        const trace_record_t *restrict record, int print_worker)
+{
+    int length = 0;
+    trace_format(buf, size, &length, "{ ");
+    trace_format(buf, size, &length, "\"time\": %u,", (unsigned int)(record->time / 1000000000));
+    switch (record->function) {
+    case IO_FUZZER_IO_READ16:
+    case IO_FUZZER_IO_READ32:
+    case IO_FUZZER_IO_READ8:
+        trace_format(buf, size, &length, "\"function\": \"%s\", \"port\": %u", io_fuzzer_function_name(record->function), record->port);
+        break;
+
+    case IO_FUZZER_IO_READ_STRING16:
+    case IO_FUZZER_IO_READ_STRING32:
+    case IO_FUZZER_IO_READ_STRING8:
+        if (header->flags & TRACE_FLAG_PAYLOAD_HASH) {
+            trace_format(buf, size, &length, "\"function\": \"%s\", \"port\": %u, \"count\": %u",
+                    io_fuzzer_function_name(record->function), record->port, record->count);
+            break;
+        }
+
+        /* fall through */
+    case IO_FUZZER_IO_WRITE_STRING16:
+    case IO_FUZZER_IO_WRITE_STRING32:
+    case IO_FUZZER_IO_WRITE_STRING8:
+        if (header->flags & TRACE_FLAG_PAYLOAD_HASH) {
+            trace_format(buf, size, &length, "\"function\": \"%s\", \"port\": %u, \"hash\": \"%016llx\", \"count\": %u",
+                    io_fuzzer_function_name(record->function), record->port, (unsigned long long)record->payload,
+                    record->count);
+        } else {
+            trace_format(buf, size, &length, "\"function\": \"%s\", \"port\": %u, \"string\": %u, \"count\": %u",
+                    io_fuzzer_function_name(record->function), record->port, (unsigned int)record->payload,
+                    record->count);
+        }
+
+        break;
+
+    case IO_FUZZER_IO_WRITE16:
+    case IO_FUZZER_IO_WRITE32:
+    case IO_FUZZER_IO_WRITE8:
+        trace_format(buf, size, &length, "\"function\": \"%s\", \"port\": %u, \"value\": %u", io_fuzzer_function_name(record->function),
+                record->port, record->value);
+        break;
+
+    case TRACE_FUNCTION_PROGRAM:
+        trace_format(buf, size, &length, "\"function\": \"program\", \"worker\": %u, \"sequence\": %llu, \"count\": %u", header->worker,
+                (unsigned long long)record->payload, record->count);
+        break;
+
+    case TRACE_FUNCTION_RACE:
+        trace_format(buf, size, &length, "\"function\": \"race\", \"round\": %llu, \"worker\": %u, \"skew\": %u, \"count\": %u",
+                (unsigned long long)record->payload, header->worker, record->value, record->count);
+        break;
+
+    case TRACE_FUNCTION_RESPONSE:
+        trace_format(buf, size, &length, "\"function\": \"response\", \"port\": %u, \"width\": %u, \"value\": %u", record->port,
+                record->width, record->value);
+        break;
+
+    case TRACE_FUNCTION_RESPONSE_STRING:
+        trace_format(buf, size, &length, "\"function\": \"response_string\", \"port\": %u, \"width\": %u, \"count\": %u, "
+                "\"crc32c\": \"%08x\"", record->port, record->width, record->count, record->value);
+        if (record->payload != 0) {
+            if (header->flags & TRACE_FLAG_PAYLOAD_HASH) {
+                trace_format(buf, size, &length, ", \"hash\": \"%016llx\"", (unsigned long long)record->payload);
+            } else {
+                trace_format(buf, size, &length, ", \"string\": %u", (unsigned int)record->payload);
+            }
+        }
+
+        break;
+
+    case TRACE_FUNCTION_EXECUTE:
+        trace_format(buf, size, &length, "\"function\": \"execute\", \"worker\": %u, \"generator\": %u, \"sequence\": %llu, "
+                "\"count\": %u", header->worker, record->value, (unsigned long long)record->payload, record->count);
+        break;
+
+    default:
+        trace_format(buf, size, &length, "\"function\": %u", record->function);
+        break;
+    }
+
+    if (print_worker && record->function != TRACE_FUNCTION_PROGRAM && record->function != TRACE_FUNCTION_RACE
+            && record->function != TRACE_FUNCTION_EXECUTE) {
+        trace_format(buf, size, &length, ", \"worker\": %u", header->worker);
+    }
+
+    trace_format(buf, size, &length, ", \"time_ns\": %llu", (unsigned long long)record->time);
+    if (record->latency != 0) {
+        trace_format(buf, size, &length, ", \"previous_latency\": %u", record->latency);
+    }
+
+    trace_format(buf, size, &length, " }\n");
+    return length;
+}
+
+int
+trace_record_format_json(char *restrict buf, size_t size, const trace_header_t *restrict header,
+        const trace_record_t *restrict record)
+{
+    return trace_record_format(buf, size, header, record, 0);
+}
+
+int
+trace_record_format_json_worker(char *restrict buf, size_t size, const trace_header_t *restrict header,
+        const trace_record_t *restrict record)
+{
+    return trace_record_format(buf, size, header, record, 1);
+}
+
+static void
+trace_record_print(FILE *restrict stream, const trace_header_t *restrict header, const trace_record_t *restrict record,
+        int print_worker)
+{
+    char buf[TRACE_RECORD_JSON_SIZE];
+    int length = trace_record_format(buf, sizeof(buf), header, record, print_worker);
+    if (length > 0) {
+        fwrite(buf, 1, ((size_t)length < sizeof(buf)) ? (size_t)length : sizeof(buf) - 1, stream);
+    }
+}
+
+void
+trace_record_print_json(
+        FILE *restrict stream, const trace_header_t *restrict header, const trace_record_t *restrict record)
+{
+    trace_record_print(stream, header, record, 0);
+}
+
+void
+trace_record_print_json_worker(
+        FILE *restrict stream, const trace_header_t *restrict header, const trace_record_t *restrict record)
+{
+    trace_record_print(stream, header, record, 1);
+}
+
+trace_writer_t *
+trace_writer_create(int fd, const trace_header_t *restrict header)
+{
+    trace_writer_t *writer = (trace_writer_t *)calloc(1, sizeof(*writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+
+    writer->fd = fd;
+    off_t offset = lseek(fd, 0, SEEK_END);
+    if (offset > 0) {
+        trace_header_t existing_header;
+        if (pread(fd, &existing_header, sizeof(existing_header), 0) != sizeof(existing_header)
+                || memcmp(&existing_header, header, offsetof(trace_header_t, worker)) != 0
+                || existing_header.flags != header->flags) {
+            free(writer);
+            errno = EINVAL;
+            return NULL;
+        }
+    } else if (write_all(fd, header, sizeof(*header)) == -1) {
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+void
+trace_writer_destroy(trace_writer_t *restrict writer)
+{
+    if (writer == NULL) {
+        return;
+    }
+
+    trace_writer_flush(writer);
+    free(writer);
+}
+
+int
+trace_writer_flush(trace_writer_t *restrict writer)
+{
+    if (writer->size == 0) {
+        return 0;
+    }
+
+    int result = write_all(writer->fd, writer->buffer, writer->size);
+    writer->size = 0;
+    return result;
+}
+
+int
+trace_writer_sync(trace_writer_t *restrict writer)
+{
+    if (trace_writer_flush(writer) == -1) {
+        return -1;
+    }
+
+    return fsync(writer->fd);
+}
+
+int
+trace_writer_write(trace_writer_t *restrict writer, const trace_record_t *restrict record)
+{
+    if (writer->size + sizeof(*record) > sizeof(writer->buffer) && trace_writer_flush(writer) == -1) {
+        return -1;
+    }
+
+    memcpy(writer->buffer + writer->size, record, sizeof(*record));
+    writer->size += sizeof(*record);
+    return 0;
+}
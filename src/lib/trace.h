@@ -0,0 +1,283 @@
+/** @file */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "IOFZTRC"
+#define TRACE_VERSION 1
+
+#define TRACE_RECORD_JSON_SIZE 512 /**< Size of a buffer large enough for any trace record as a JSON line. */
+
+#define TRACE_FLAG_PAYLOAD_HASH 0x1 /**< Payloads of string writes are blob store hashes. */
+
+/** Trace record functions other than the I/O address space fuzzer functions. */
+enum {
+    TRACE_FUNCTION_PROGRAM = 0x80,  /**< Program of the pipeline mode. */
+    TRACE_FUNCTION_RACE,            /**< Round of the race mode. */
+    TRACE_FUNCTION_RESPONSE,        /**< Response of a read operation. */
+    TRACE_FUNCTION_RESPONSE_STRING, /**< Response of a string read operation. */
+    TRACE_FUNCTION_EXECUTE          /**< Program about to be performed by the executor of the pipeline mode. */
+};
+
+/** Trace file header. */
+typedef struct _trace_header {
+    char magic[8];        /**< TRACE_MAGIC. */
+    uint32_t version;     /**< TRACE_VERSION. */
+    uint32_t record_size; /**< Size of each record, in bytes. */
+    uint32_t worker;      /**< Worker number. */
+    uint32_t flags;       /**< Flags (i.e., TRACE_FLAG_PAYLOAD_HASH). */
+    uint64_t seed;        /**< Seed of the pseudorandom number generator. */
+} trace_header_t;
+
+/**
+ * Trace record.
+ *
+ * Program records have the program sequence number in the payload, execute
+ * records have the program sequence number in the payload and the generator in
+ * the value, and race records have the round in the payload and the skew, in
+ * nanoseconds, in the value. Response records have the value read, or the count
+ * and CRC-32C of the string read in the value (and its address, if captured, in
+ * the payload), and the time and latency of the read operation; they follow the
+ * records of their operations in order, after those of the whole round or
+ * program in race and pipeline modes. If the header has
+ * TRACE_FLAG_PAYLOAD_HASH, string writes have the hash of the string in the
+ * blob store in the payload, string reads have no payload, and responses have
+ * the hash of the string read, if captured.
+ */
+typedef struct _trace_record {
+    uint64_t sequence; /**< Sequence number. */
+    uint64_t time;     /**< Time, in nanoseconds since the epoch. */
+    uint64_t payload;  /**< Payload reference (i.e., address or hash of the string). */
+    uint32_t value;    /**< Value written. */
+    uint32_t count;    /**< Number of values of the string. */
+    uint32_t latency;  /**< Latency of the operation of the previous record, in nanoseconds (0 if unknown). */
+    uint16_t port;     /**< I/O port address. */
+    uint8_t function;  /**< Function. */
+    uint8_t width;     /**< Size of each value, in bytes. */
+} trace_record_t;
+
+typedef struct _trace_reader trace_reader_t; /**< Reader of binary or JSON lines trace files. */
+typedef struct _trace_writer trace_writer_t; /**< Trace writer. */
+
+/**
+ * Gets the function of a name (i.e., an I/O address space fuzzer function name,
+ * or program, race, response, response_string, or execute).
+ *
+ * @param [in] name Name of the function.
+ * @return Function, or -1 if the name is invalid.
+ */
+int trace_function_from_name(const char *name);
+
+/**
+ * Initializes a trace file header.
+ *
+ * @param [out] header Trace file header.
+ * @param [in] worker Worker number.
+ * @param [in] seed Seed of the pseudorandom number generator.
+ */
+void trace_header_init(trace_header_t *restrict header, uint32_t worker, uint64_t seed);
+
+/**
+ * Reads a trace file header from the stream.
+ *
+ * @param [in] stream Input stream.
+ * @param [out] header Trace file header.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int trace_read_header(FILE *restrict stream, trace_header_t *restrict header);
+
+/**
+ * Reads a trace record from the stream.
+ *
+ * @param [in] stream Input stream.
+ * @param [in] header Trace file header.
+ * @param [out] record Trace record.
+ * @return 1 on success, 0 at the end of the stream (or at the zeroed,
+ *   preallocated tail of a segment that was not closed); otherwise, -1 and
+ *   errno is set to indicate the error.
+ */
+int trace_read_record(FILE *restrict stream, const trace_header_t *restrict header, trace_record_t *restrict record);
+
+/**
+ * Creates a trace reader for the stream, which may be a binary trace file or
+ * JSON lines (as printed by trace_record_print_json()), detected by its first
+ * byte.
+ *
+ * @param [in] stream Input stream.
+ * @return A trace reader, or NULL and errno is set to indicate the error.
+ */
+trace_reader_t *trace_reader_create(FILE *restrict stream);
+
+/**
+ * Destroys the trace reader. (The stream is not closed.)
+ *
+ * @param [in] reader Trace reader.
+ */
+void trace_reader_destroy(trace_reader_t *restrict reader);
+
+/**
+ * Gets the trace file header of the trace reader. (For JSON lines, it has
+ * TRACE_FLAG_PAYLOAD_HASH once a record with a hash is read.)
+ *
+ * @param [in] reader Trace reader.
+ * @return Trace file header.
+ */
+const trace_header_t *trace_reader_get_header(const trace_reader_t *restrict reader);
+
+/**
+ * Gets the number of the last line read by the trace reader (for JSON lines),
+ * or the number of records read (for binary trace files).
+ *
+ * @param [in] reader Trace reader.
+ * @return Number of the last line read.
+ */
+uint64_t trace_reader_get_line(const trace_reader_t *restrict reader);
+
+/**
+ * Checks whether the trace reader reads JSON lines. (Their header has no
+ * worker number or seed.)
+ *
+ * @param [in] reader Trace reader.
+ * @return 1 if the trace reader reads JSON lines; otherwise, 0.
+ */
+int trace_reader_is_json(const trace_reader_t *restrict reader);
+
+/**
+ * Reads a trace record. (Records of JSON lines are numbered in the order they
+ * are read, as they have no sequence number.)
+ *
+ * @param [in] reader Trace reader.
+ * @param [out] record Trace record.
+ * @return 1 on success, 0 at the end of the stream; otherwise, -1 and errno is
+ *   set to indicate the error (EINVAL if the record is invalid).
+ */
+int trace_reader_read(trace_reader_t *restrict reader, trace_record_t *restrict record);
+
+/**
+ * Parses a trace record from a JSON line, as printed by
+ * trace_record_print_json(). The line is scanned in place, without allocating
+ * memory (i.e., the strings are terminated in the line), and only the subset
+ * of JSON printed is accepted (i.e., a flat object of unsigned integers and
+ * strings without escape sequences). Values wider than the width of the
+ * record are rejected.
+ *
+ * @param [in,out] line Line, terminated by a null character.
+ * @param [out] record Trace record.
+ * @param [in,out] flags Trace file header flags (TRACE_FLAG_PAYLOAD_HASH is set
+ *   if the record has a hash).
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int trace_record_parse_json(char *restrict line, trace_record_t *restrict record, uint32_t *restrict flags);
+
+/**
+ * Formats a trace record as a JSON line, as printed by
+ * trace_record_print_json(), into the buffer (e.g., for log handlers that
+ * write the line without a stream). The line is truncated and terminated by a
+ * null character if the buffer is too small; a buffer of
+ * TRACE_RECORD_JSON_SIZE bytes is large enough for any trace record.
+ *
+ * @param [out] buf Buffer.
+ * @param [in] size Size of the buffer.
+ * @param [in] header Trace file header.
+ * @param [in] record Trace record.
+ * @return Length of the line (excluding the null character) that would have
+ *   been written if the buffer were large enough, as snprintf(); otherwise,
+ *   -1 and errno is set to indicate the error.
+ */
+int trace_record_format_json(char *restrict buf, size_t size, const trace_header_t *restrict header,
+        const trace_record_t *restrict record);
+
+/**
+ * Formats a trace record as a JSON line with the worker number of the trace
+ * file, as printed by trace_record_print_json_worker(), into the buffer. (See
+ * trace_record_format_json().)
+ *
+ * @param [out] buf Buffer.
+ * @param [in] size Size of the buffer.
+ * @param [in] header Trace file header.
+ * @param [in] record Trace record.
+ * @return Length of the line (excluding the null character) that would have
+ *   been written if the buffer were large enough; otherwise, -1 and errno is
+ *   set to indicate the error.
+ */
+int trace_record_format_json_worker(char *restrict buf, size_t size, const trace_header_t *restrict header,
+        const trace_record_t *restrict record);
+
+/**
+ * Prints a trace record as a JSON line.
+ *
+ * @param [in] stream Output stream.
+ * @param [in] header Trace file header.
+ * @param [in] record Trace record.
+ */
+void trace_record_print_json(
+        FILE *restrict stream, const trace_header_t *restrict header, const trace_record_t *restrict record);
+
+/**
+ * Prints a trace record as a JSON line with the worker number of the trace
+ * file (e.g., for records of multiple trace files merged into one stream).
+ *
+ * @param [in] stream Output stream.
+ * @param [in] header Trace file header.
+ * @param [in] record Trace record.
+ */
+void trace_record_print_json_worker(
+        FILE *restrict stream, const trace_header_t *restrict header, const trace_record_t *restrict record);
+
+/**
+ * Creates a trace writer that buffers records for the file descriptor. The
+ * header is written if the file is empty or not seekable; otherwise, it is
+ * checked against the existing one.
+ *
+ * @param [in] fd File descriptor.
+ * @param [in] header Trace file header.
+ * @return A trace writer, or NULL and errno is set to indicate the error.
+ */
+trace_writer_t *trace_writer_create(int fd, const trace_header_t *restrict header);
+
+/**
+ * Destroys the trace writer, flushing its buffer. (The file descriptor is not
+ * closed.)
+ *
+ * @param [in] writer Trace writer.
+ */
+void trace_writer_destroy(trace_writer_t *restrict writer);
+
+/**
+ * Writes the buffered records to the file descriptor.
+ *
+ * @param [in] writer Trace writer.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int trace_writer_flush(trace_writer_t *restrict writer);
+
+/**
+ * Writes the buffered records to the file descriptor and synchronizes it with
+ * the storage device.
+ *
+ * @param [in] writer Trace writer.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int trace_writer_sync(trace_writer_t *restrict writer);
+
+/**
+ * Appends a record to the buffer of the trace writer, flushing it if full.
+ *
+ * @param [in] writer Trace writer.
+ * @param [in] record Trace record.
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+int trace_writer_write(trace_writer_t *restrict writer, const trace_record_t *restrict record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_H */
@@ -0,0 +1,66 @@
+/** @file */
+
+#include "tsc.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define CALIBRATION_NS 10000000
+#define CALIBRATION_ROUNDS 3
+
+static uint64_t
+clock_read(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t
+tsc_calibrate(void)
+{
+    uint64_t frequency = 0;
+    for (int i = 0; i < CALIBRATION_ROUNDS; ++i) {
+        uint64_t begin_ns = clock_read();
+        uint64_t begin = tsc_read();
+        uint64_t end_ns = begin_ns;
+        while (end_ns - begin_ns < CALIBRATION_NS) {
+            end_ns = clock_read();
+        }
+
+        uint64_t end = tsc_read();
+        uint64_t round = (end - begin) * 1000000000.0 / (end_ns - begin_ns);
+        if (frequency == 0 || round < frequency) {
+            frequency = round;
+        }
+    }
+
+    return frequency;
+}
+
+void
+tsc_clock_init(tsc_clock_t *restrict clock, uint64_t frequency)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    clock->tsc = tsc_read();
+    clock->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    clock->frequency = frequency;
+    clock->mult = (frequency != 0) ? (((unsigned __int128)1000000000 << 32) / frequency) : 0;
+}
+
+uint64_t
+tsc_from_ns(uint64_t frequency, uint64_t ns)
+{
+    return (unsigned __int128)ns * frequency / 1000000000;
+}
+
+uint64_t
+tsc_to_ns(uint64_t frequency, uint64_t cycles)
+{
+    if (frequency == 0) {
+        return 0;
+    }
+
+    return (unsigned __int128)cycles * 1000000000 / frequency;
+}
@@ -0,0 +1,140 @@
+/** @file */
+
+#ifndef TSC_H
+#define TSC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** Time-stamp counter calibrated against the realtime clock. */
+typedef struct _tsc_clock {
+    uint64_t frequency; /**< Frequency of the time-stamp counter, in Hz. */
+    uint64_t tsc;       /**< Value of the time-stamp counter at the reference time. */
+    uint64_t time;      /**< Reference time, in nanoseconds since the epoch. */
+    uint64_t mult;      /**< Nanoseconds per cycle, in 32.32 fixed point. */
+} tsc_clock_t;
+
+/**
+ * Reads the time-stamp counter.
+ *
+ * @return Value of the time-stamp counter.
+ */
+static inline uint64_t
+tsc_read(void)
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Reads the time-stamp counter after all previous instructions have completed,
+ * for the beginning of a measurement.
+ *
+ * @return Value of the time-stamp counter.
+ */
+static inline uint64_t
+tsc_begin(void)
+{
+    uint32_t low, high;
+    asm volatile("lfence; rdtsc" : "=a"(low), "=d"(high) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Reads the time-stamp counter before any subsequent instruction begins, for
+ * the end of a measurement.
+ *
+ * @return Value of the time-stamp counter.
+ */
+static inline uint64_t
+tsc_end(void)
+{
+    uint32_t low, high;
+    asm volatile("rdtscp; lfence" : "=a"(low), "=d"(high) : : "ecx", "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Converts a number of time-stamp counter cycles to nanoseconds using the
+ * calibration of the clock. (No division.)
+ *
+ * @param [in] clock Clock.
+ * @param [in] cycles Number of time-stamp counter cycles.
+ * @return Number of nanoseconds.
+ */
+static inline uint64_t
+tsc_clock_to_ns(const tsc_clock_t *restrict clock, uint64_t cycles)
+{
+    return ((unsigned __int128)cycles * clock->mult) >> 32;
+}
+
+/**
+ * Gets the current time from the time-stamp counter.
+ *
+ * @param [in] clock Clock.
+ * @return Current time, in nanoseconds since the epoch.
+ */
+static inline uint64_t
+tsc_clock_now(const tsc_clock_t *restrict clock)
+{
+    return clock->time + tsc_clock_to_ns(clock, tsc_read() - clock->tsc);
+}
+
+/**
+ * Busy-waits until the time-stamp counter reaches the deadline.
+ *
+ * @param [in] deadline Value of the time-stamp counter to wait for.
+ */
+static inline void
+tsc_wait_until(uint64_t deadline)
+{
+    while (tsc_read() < deadline) {
+        asm volatile("pause");
+    }
+}
+
+/**
+ * Calibrates the time-stamp counter against the monotonic clock.
+ *
+ * @return Frequency of the time-stamp counter, in Hz, or 0 if it could not be
+ *   calibrated.
+ */
+uint64_t tsc_calibrate(void);
+
+/**
+ * Initializes a clock, taking the current time of the realtime clock as the
+ * reference time.
+ *
+ * @param [out] clock Clock.
+ * @param [in] frequency Frequency of the time-stamp counter, in Hz (see
+ *   tsc_calibrate()).
+ */
+void tsc_clock_init(tsc_clock_t *restrict clock, uint64_t frequency);
+
+/**
+ * Converts a number of nanoseconds to time-stamp counter cycles.
+ *
+ * @param [in] frequency Frequency of the time-stamp counter, in Hz.
+ * @param [in] ns Number of nanoseconds.
+ * @return Number of time-stamp counter cycles.
+ */
+uint64_t tsc_from_ns(uint64_t frequency, uint64_t ns);
+
+/**
+ * Converts a number of time-stamp counter cycles to nanoseconds.
+ *
+ * @param [in] frequency Frequency of the time-stamp counter, in Hz.
+ * @param [in] cycles Number of time-stamp counter cycles.
+ * @return Number of nanoseconds.
+ */
+uint64_t tsc_to_ns(uint64_t frequency, uint64_t cycles);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSC_H */
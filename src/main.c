@@ -4,13 +4,37 @@
 #include "config.h"
 #endif
 
+#ifdef IO_DRY_RUN
+#error "IO_DRY_RUN is only for iofuzzer-bench-dry-run"
+#endif
+
 #include "../lib/error.h"
 #include "../lib/string.h"
+#include "lib/barrier.h"
+#include "lib/blob.h"
+#include "lib/commit.h"
+#include "lib/console.h"
+#include "lib/cpu.h"
+#include "lib/device.h"
+#include "lib/exporter.h"
+#include "lib/fiber.h"
+#include "lib/input.h"
 #include "lib/io_fuzzer.h"
+#include "lib/logger.h"
+#include "lib/program.h"
+#include "lib/recorder.h"
+#include "lib/replay.h"
+#include "lib/ring.h"
+#include "lib/segment.h"
+#include "lib/trace.h"
+#include "lib/tsc.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -19,32 +43,185 @@
 #include <time.h>
 
 #include <sys/io.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
+#define EXPORT_INTERVAL_MS 1000
+#define FIBER_MAX_POLLS 16
+#define LOG_RING_SLOTS 4096
+#define MAX_IO_RANGES 16
 #define MAX_PORTS 65536
+#define PIPELINE_CAPACITY (4 * IO_FUZZER_MAX_STRING)
+#define PIPELINE_MAX_OPERATIONS 64
+#define PIPELINE_SLOTS 8
+#define RACE_MARGIN_NS 10000
+#define RANDOM_STATE_SIZE 128
 
 #define usage() \
     fprintf(stderr, \
             "Usage: %s [OPTION]... [INPUT]\n" \
             "Options:\n" \
-            "  -d, --debug           Enable debug mode.\n" \
+            "      --async-log       Write the records from a separate logger thread.\n" \
+            "      --blob-store=FILE Store the strings written once in the specified file,\n" \
+            "                        keyed by their hash, and log only the hash.\n" \
+            "      --capture-reads[=full]\n" \
+            "                        Log the values read and the CRC-32C of the strings\n" \
+            "                        read (and store the strings read in the blob store).\n" \
+            "      --cpu=LIST        Specify the list of CPUs to pin the threads to. (The\n" \
+            "                        first is the executor's in pipeline mode.)\n" \
+            "  -d, --debug           Enable debug mode (log every operation performed).\n" \
+            "      --exclude-output-device\n" \
+            "                        Exclude the I/O ports of the devices the output files\n" \
+            "                        are stored on from fuzzing.\n" \
+            "      --export=DIR      Copy the output files to the specified directory\n" \
+            "                        periodically (e.g., from tmpfs to another disk).\n" \
+            "      --export-interval=NUM\n" \
+            "                        Specify the interval, in milliseconds, between exports.\n" \
+            "                        (The default is 1000.)\n" \
+            "      --fiber-polls=NUM Specify the maximum number of polls of each read in\n" \
+            "                        fiber mode. (The default is 16.)\n" \
+            "      --fibers=NUM      Run the specified number of sequences interleaved on\n" \
+            "                        each worker thread, each polling the port of a read\n" \
+            "                        until the masked value read is the value generated,\n" \
+            "                        and yielding to the other sequences between polls.\n" \
+            "  -f, --format=FORMAT   Specify the output format (i.e., binary or json). (The\n" \
+            "                        default is binary for output files and json for the\n" \
+            "                        standard output.)\n" \
+            "      --flight-recorder=SIZE@ADDRESS\n" \
+            "                        Keep the last records of each worker in the reserved\n" \
+            "                        memory region at the specified physical address (see\n" \
+            "                        the memmap kernel parameter).\n" \
+            "      --flight-recorder-device=FILE\n" \
+            "                        Specify the file the flight recorder is mapped from.\n" \
+            "                        (The default is /dev/mem.)\n" \
             "  -g, --generate        Use the pseudorandom number generator (i.e., random())\n" \
             "                        for input generation.\n" \
             "  -h, --help            Display help information and exit.\n" \
+            "  -j, --jobs=NUM        Specify the number of worker threads, each pinned to a\n" \
+            "                        distinct CPU. (The default is 1.)\n" \
+            "      --log-port=PORT   Write the records to the specified debug console port\n" \
+            "                        (e.g., 0xe9) instead of an output file.\n" \
+            "      --log-uart=PORT   Write the records to the 16550 UART at the specified base\n" \
+            "                        address (e.g., 0x3f8) instead of an output file.\n" \
+            "      --log-overflow=POLICY\n" \
+            "                        Specify what to do when the logger thread falls behind\n" \
+            "                        (i.e., block, drop, or drop-oldest). (Implies\n" \
+            "                        --async-log. The default is block.)\n" \
+            "      --mlock           Lock all pages of the process in memory.\n" \
             "  -o, --output=FILE     Specify the output file name.\n" \
             "  -p, --ports=LIST      Specify the list of I/O port addresses. (The default is\n" \
             "                        all ports.)\n" \
-            "  -q, --quiet           Enable quiet mode.\n" \
+            "      --pipeline=NUM    Decode operations in the specified number of generator\n" \
+            "                        threads and perform them in a separate executor thread.\n" \
+            "  -q, --quiet           Enable quiet mode (log nothing).\n" \
+            "      --recover         Print the records kept by the flight recorder and exit.\n" \
+            "      --repeat=NUM      Specify the number of times the trace is replayed (0 to\n" \
+            "                        replay it until interrupted). (The default is 1.)\n" \
+            "      --replay=FILE     Perform the operations of the specified trace file\n" \
+            "                        (binary or JSON lines) again.\n" \
+            "      --replay-range=FIRST[-LAST]\n" \
+            "                        Specify the indexes of the first and last operations\n" \
+            "                        of the trace to replay.\n" \
+            "      --replay-timing[=SCALE]\n" \
+            "                        Reproduce the recorded gaps between the operations,\n" \
+            "                        multiplied by the specified factor. (The default is\n" \
+            "                        1.)\n" \
+            "  -r, --race            Run the operations of all workers concurrently against\n" \
+            "                        the same ports, released from a common barrier and\n" \
+            "                        skewed by a pseudorandom delay.\n" \
+            "      --race-length=NUM Specify the number of operations of each worker per\n" \
+            "                        round in race mode. (The default is 4.)\n" \
+            "      --sched-fifo[=NUM]\n" \
+            "                        Run the threads that perform operations with the\n" \
+            "                        SCHED_FIFO policy and the specified priority. (The\n" \
+            "                        default is 1.)\n" \
             "  -s, --seed=NUM        Specify the seed for the pseudorandom number generator.\n" \
             "                        (The default is 1.)\n" \
+            "      --segment-size=SIZE\n" \
+            "                        Write the output files as segments of the specified\n" \
+            "                        size, preallocated and written with O_DIRECT.\n" \
+            "      --segments=NUM    Specify the maximum number of segments kept for each\n" \
+            "                        output file. (The default is no limit.)\n" \
+            "      --sync=POLICY     Specify when to synchronize the output files (i.e.,\n" \
+            "                        every, none, NUM records, or NUMms milliseconds). (The\n" \
+            "                        default is every.)\n" \
+            "      --skew=NUM        Specify the maximum delay, in nanoseconds, of each\n" \
+            "                        worker after the barrier in race mode, up to\n" \
+            "                        2147483647. (The default is 1000.)\n" \
             "  -t, --timeout=NUM     Specify the timeout, in seconds, for each iteration.\n" \
             "                        (The default is 5.)\n" \
-            "  -v, --verbose         Enable verbose mode.\n" \
+            "  -v, --verbose         Enable verbose mode (log the configuration).\n" \
             "      --version         Display version information and exit.\n", \
             PACKAGE_NAME)
 
 #define version() fprintf(stderr, "%s\n", PACKAGE_STRING)
 
+typedef struct __attribute__((aligned(64))) _worker {
+    pthread_t thread;
+    size_t id;
+    int cpu;
+    unsigned long seed;
+    io_fuzzer_t *io_fuzzer;
+    FILE *log_stream;
+    segment_writer_t *segments;
+    trace_header_t header;
+    trace_writer_t *writer;
+    console_t *console;
+    int print_worker;
+    commit_t commit;
+    blob_store_t *blob_store;
+    blob_buffer_t *blob_buffer;
+    recorder_ring_t *recorder_ring;
+    io_fuzzer_log_handler_t *log_handler;
+    void *log_context;
+    logger_channel_t *channel;
+    uint64_t drops;
+    struct random_data random_data;
+    char random_state[RANDOM_STATE_SIZE];
+    io_fuzzer_operation_t *operations;
+    size_t num_operations;
+    uint64_t skew;
+    size_t num_fibers;
+    unsigned long max_polls;
+    uint64_t tsc_frequency;
+    ring_t *ring;
+    struct _worker *generators;
+    size_t num_generators;
+    uint64_t idle;
+    int priority;
+    long involuntary_switches;
+    uint64_t iterations;
+    struct timespec start;
+    struct timespec end;
+} worker_t; /**< Worker thread. */
+
+typedef struct _replay_timing {
+    double scale;         /**< Scale factor of the recorded gaps (0 to replay at full speed). */
+    uint64_t num_gaps;    /**< Number of gaps between operations replayed. */
+    uint64_t num_late;    /**< Number of operations performed after the end of their gap. */
+    uint64_t recorded;    /**< Sum of the scaled recorded gaps, in cycles. */
+    uint64_t replayed;    /**< Sum of the replayed gaps, in cycles. */
+    uint64_t total_error; /**< Sum of the differences between the replayed and scaled recorded gaps, in cycles. */
+    uint64_t max_error;   /**< Maximum difference between a replayed and scaled recorded gap, in cycles. */
+} replay_timing_t; /**< Timing of a replay. */
+
+typedef struct _sequence {
+    worker_t *worker; /**< Worker thread the sequence runs on. */
+    uint8_t *buf;     /**< Input buffer of IO_FUZZER_MAX_INPUT bytes. */
+    uint8_t *string;  /**< String of IO_FUZZER_MAX_STRING bytes. */
+} sequence_t; /**< Sequence run by a fiber in fiber mode. */
+
+typedef struct _worker_pool {
+    worker_t *workers;  /**< Workers. */
+    size_t num_workers; /**< Number of workers. */
+} worker_pool_t; /**< Workers whose output is flushed on abort. */
+
+static barrier_t barrier;
+static tsc_clock_t tsc_clock;
+static logger_t *logger = NULL;
+static volatile sig_atomic_t stop = 0;
+
 void
 default_error_handler(int status, int error, const char *restrict format, va_list ap)
 {
@@ -59,243 +236,1945 @@ default_error_handler(int status, int error, const char *restrict format, va_lis
 }
 
 void
-default_log_handler(FILE *restrict stream, const char *restrict format, va_list ap)
+abort_handler(int signum)
 {
-    flockfile(stream);
-    fprintf(stream, "{ ");
-    fprintf(stream, "\"time\": %d,", (unsigned int)time(NULL));
-    for (size_t i = 0; format[i] != '\0'; ++i) {
-        if (i > 0) {
-            fprintf(stream, ", ");
-        }
+    logger_flush(logger);
+}
 
-        fprintf(stream, "\"%s\": ", va_arg(ap, char *));
-        switch (format[i]) {
-        case 'c':
-            fprintf(stream, "\"%c\"", va_arg(ap, int));
-            break;
+void
+binary_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    worker_t *worker = (worker_t *)context;
+    commit_lock(&worker->commit);
+    if (trace_writer_write(worker->writer, record) == -1) {
+        perror("trace_writer_write");
+        exit(EXIT_FAILURE);
+    }
 
-        case 'd':
-            fprintf(stream, "%d", va_arg(ap, int));
-            break;
+    if (commit_record(&worker->commit) == -1) {
+        perror("commit_record");
+        exit(EXIT_FAILURE);
+    }
 
-        case 'f':
-            fprintf(stream, "%f", va_arg(ap, double));
-            break;
+    commit_unlock(&worker->commit);
+}
 
-        case 'o':
-            fprintf(stream, "%o", va_arg(ap, unsigned int));
-            break;
+void
+binary_console_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    worker_t *worker = (worker_t *)context;
+    console_write(worker->console, record, sizeof(*record));
+}
 
-        case 'p':
-            fprintf(stream, "%p", va_arg(ap, void *));
-            break;
+void
+default_console_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    worker_t *worker = (worker_t *)context;
+    char buf[TRACE_RECORD_JSON_SIZE];
+    int length = worker->print_worker ? trace_record_format_json_worker(buf, sizeof(buf), &worker->header, record)
+                                      : trace_record_format_json(buf, sizeof(buf), &worker->header, record);
+    if (length == -1) {
+        perror("trace_record_format_json");
+        exit(EXIT_FAILURE);
+    }
 
-        case 'q':
-            fprintf(stream, "%llu", va_arg(ap, unsigned long long int));
-            break;
+    console_write(worker->console, buf, length);
+}
 
-        case 's':
-            fprintf(stream, "\"%s\"", va_arg(ap, char *));
-            break;
+void
+binary_segment_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    worker_t *worker = (worker_t *)context;
+    commit_lock(&worker->commit);
+    if (segment_writer_write(worker->segments, record, sizeof(*record)) == -1) {
+        perror("segment_writer_write");
+        exit(EXIT_FAILURE);
+    }
 
-        case 'u':
-            fprintf(stream, "%u", va_arg(ap, unsigned int));
-            break;
+    if (commit_record(&worker->commit) == -1) {
+        perror("commit_record");
+        exit(EXIT_FAILURE);
+    }
 
-        case 'x':
-            fprintf(stream, "%x", va_arg(ap, unsigned int));
-            break;
+    commit_unlock(&worker->commit);
+}
 
-        case 'z':
-            fprintf(stream, "%zu", va_arg(ap, size_t));
-            break;
+void
+default_segment_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    worker_t *worker = (worker_t *)context;
+    char buf[TRACE_RECORD_JSON_SIZE];
+    int length = trace_record_format_json(buf, sizeof(buf), &worker->header, record);
+    if (length == -1) {
+        perror("trace_record_format_json");
+        exit(EXIT_FAILURE);
+    }
 
-        default:
-            abort();
-        }
+    commit_lock(&worker->commit);
+    if (segment_writer_write(worker->segments, buf, length) == -1) {
+        perror("segment_writer_write");
+        exit(EXIT_FAILURE);
     }
 
-    fprintf(stream, " }\n");
-    fflush(stream);
-    fsync(fileno(stream));
-    funlockfile(stream);
+    if (commit_record(&worker->commit) == -1) {
+        perror("commit_record");
+        exit(EXIT_FAILURE);
+    }
+
+    commit_unlock(&worker->commit);
 }
 
 void
-random_buf(void *buf, size_t size)
+default_log_handler(void *restrict context, const trace_record_t *restrict record)
 {
-    uint32_t number = 0;
-    for (size_t i = 0; i < size; ++i) {
-        if ((i % sizeof(uint16_t)) == 0) {
-            number = random();
+    worker_t *worker = (worker_t *)context;
+
+    /* The generators and the executor of the pipeline mode may share the standard output. */
+    flockfile(worker->log_stream);
+    commit_lock(&worker->commit);
+    trace_record_print_json(worker->log_stream, &worker->header, record);
+    fflush(worker->log_stream);
+    if (commit_record(&worker->commit) == -1) {
+        perror("commit_record");
+        exit(EXIT_FAILURE);
+    }
+
+    commit_unlock(&worker->commit);
+    funlockfile(worker->log_stream);
+}
+
+int
+ports_overlap(const int *ports, size_t num_ports, int first, int last)
+{
+    if (ports == NULL) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < num_ports; ++i) {
+        if (ports[i] >= first && ports[i] <= last) {
+            return 1;
         }
+    }
 
-        ((uint8_t *)buf)[i] = (number >> (8 * (i % sizeof(uint16_t)))) & 0xff;
+    return 0;
+}
+
+int
+exclude_ports(int **ports, size_t *num_ports, int first, int last)
+{
+    if (*ports == NULL) {
+        *ports = (int *)calloc(MAX_PORTS, sizeof(**ports));
+        if (*ports == NULL) {
+            return -1;
+        }
+
+        for (int i = 0; i < MAX_PORTS; ++i) {
+            (*ports)[i] = i;
+        }
+
+        *num_ports = MAX_PORTS;
     }
+
+    size_t j = 0;
+    for (size_t i = 0; i < *num_ports; ++i) {
+        if ((*ports)[i] < first || (*ports)[i] > last) {
+            (*ports)[j++] = (*ports)[i];
+        }
+    }
+
+    *num_ports = j;
+    if (*num_ports == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
 }
 
 int
-main(int argc, char *argv[])
+worker_flush(void *context)
 {
-    int c = 0;
-    enum
-    {
-        OPT_VERSION = CHAR_MAX + 1,
-    };
-    /* clang-format off */
-    static struct option longopts[] = {
-        {"debug",       no_argument,       NULL, 'd'             },
-        {"generate",    no_argument,       NULL, 'g'             },
-        {"help",        no_argument,       NULL, 'h'             },
-        {"output",      required_argument, NULL, 'o'             },
-        {"ports",       required_argument, NULL, 'p'             },
-        {"quiet",       no_argument,       NULL, 'q'             },
-        {"seed",        required_argument, NULL, 's'             },
-        {"timeout",     required_argument, NULL, 't'             },
-        {"verbose",     no_argument,       NULL, 'v'             },
-        {"version",     no_argument,       NULL, OPT_VERSION     },
-        {NULL,          0,                 NULL, 0               }
-    };
-    /* clang-format on */
-    static int longindex = 0;
-    int debug = 0;
-    int generate = 0;
-    char *input = NULL;
-    char *output = NULL;
-    int *ports = NULL;
-    size_t num_ports = 0;
-    int quiet = 0;
-    unsigned long seed = 1;
-    int timeout = 5;
-    int verbose = 0;
-    while ((c = getopt_long(argc, argv, "dgho:p:qs:t:v", longopts, &longindex)) != -1) {
-        switch (c) {
-        case 'd':
-            debug = 1;
-            break;
+    worker_t *worker = (worker_t *)context;
 
-        case 'g':
-            generate = 1;
-            break;
+    /* The strings must be stored before the records that refer to them by hash are committed. */
+    if (worker->blob_buffer != NULL
+            && (blob_buffer_flush(worker->blob_buffer) == -1 || blob_store_sync(worker->blob_store) == -1)) {
+        return -1;
+    }
 
-        case 'h':
-            usage();
-            exit(EXIT_FAILURE);
+    if (worker->segments != NULL) {
+        if (segment_writer_flush(worker->segments) == -1) {
+            return -1;
+        }
 
-        case 'o':
-            output = optarg;
-            break;
+        return segment_writer_get_fd(worker->segments);
+    }
 
-        case 'p':
-            if (string_split_range(optarg, ",", MAX_PORTS, &ports, &num_ports) == -1) {
-                perror("getlist");
-                exit(EXIT_FAILURE);
-            }
+    if (worker->writer != NULL && trace_writer_flush(worker->writer) == -1) {
+        return -1;
+    }
 
-            break;
+    return fileno(worker->log_stream);
+}
 
-        case 'q':
-            quiet = 1;
-            break;
+void
+workers_flush(void *context)
+{
+    const worker_pool_t *pool = (const worker_pool_t *)context;
 
-        case 's':
-            errno = 0;
-            seed = strtoul(optarg, NULL, 0);
-            if (errno != 0) {
-                perror("strtoul");
-                exit(EXIT_FAILURE);
-            }
+    /* The records buffered by the log handlers are written out even if they are not due to be committed. */
+    for (size_t i = 0; i < pool->num_workers; ++i) {
+        worker_t *worker = &pool->workers[i];
+        if (worker->writer == NULL && worker->segments == NULL) {
+            continue;
+        }
+
+        commit_lock(&worker->commit);
+        worker_flush(worker);
+        commit_unlock(&worker->commit);
+    }
+}
 
+void
+worker_log_handler(void *restrict context, const trace_record_t *restrict record)
+{
+    worker_t *worker = (worker_t *)context;
+    trace_record_t blob_record;
+    if (worker->blob_store != NULL) {
+        switch (record->function) {
+        case IO_FUZZER_IO_READ_STRING16:
+        case IO_FUZZER_IO_READ_STRING32:
+        case IO_FUZZER_IO_READ_STRING8:
+            blob_record = *record;
+            blob_record.payload = 0;
+            record = &blob_record;
             break;
 
-        case 't':
-            errno = 0;
-            timeout = strtoul(optarg, NULL, 0);
-            if (errno != 0) {
-                perror("strtoul");
+        case TRACE_FUNCTION_RESPONSE_STRING:
+            if (record->payload == 0) {
+                break;
+            }
+
+            /* fall through */
+        case IO_FUZZER_IO_WRITE_STRING16:
+        case IO_FUZZER_IO_WRITE_STRING32:
+        case IO_FUZZER_IO_WRITE_STRING8:
+            blob_record = *record;
+            if (blob_buffer_put(worker->blob_buffer, (const void *)(uintptr_t)record->payload,
+                        (size_t)record->count * record->width, &blob_record.payload) == -1) {
+                perror("blob_buffer_put");
                 exit(EXIT_FAILURE);
             }
 
+            record = &blob_record;
             break;
 
-        case 'v':
-            verbose = 1;
+        default:
             break;
+        }
+    }
 
-        case OPT_VERSION:
-            version();
-            exit(EXIT_FAILURE);
+    if (worker->recorder_ring != NULL) {
+        recorder_write(worker->recorder_ring, record);
+    }
 
-        default:
-            usage();
-            exit(EXIT_FAILURE);
+    if (worker->log_handler != NULL) {
+        worker->log_handler(worker->log_context, record);
+    }
+}
+
+int
+parse_size(const char *restrict str, char **restrict end, uint64_t *restrict size)
+{
+    errno = 0;
+    *size = strtoull(str, end, 0);
+    if (errno != 0) {
+        return -1;
+    }
+
+    if (*end == str) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int shift = 0;
+    switch (**end) {
+    case 'G':
+        shift = 30;
+        break;
+
+    case 'K':
+        shift = 10;
+        break;
+
+    case 'M':
+        shift = 20;
+        break;
+    }
+
+    if (shift != 0) {
+        if (*size > (UINT64_MAX >> shift)) {
+            errno = ERANGE;
+            return -1;
         }
+
+        *size <<= shift;
+        ++*end;
     }
 
-    FILE *stream = stdout;
-    if (output != NULL) {
-        stream = fopen(output, "a+");
-        if (stream == NULL) {
-            perror("fopen");
-            exit(EXIT_FAILURE);
+    return 0;
+}
+
+void
+random_buf(struct random_data *restrict random_data, void *buf, size_t size)
+{
+    int32_t number = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if ((i % sizeof(uint16_t)) == 0) {
+            random_r(random_data, &number);
         }
+
+        ((uint8_t *)buf)[i] = (number >> (8 * (i % sizeof(uint16_t)))) & 0xff;
     }
+}
 
-    if (iopl(3) == -1) {
-        perror("iopl");
+void
+stop_handler(int signum)
+{
+    stop = 1;
+    barrier_cancel(&barrier);
+}
+
+void
+worker_begin(worker_t *restrict worker)
+{
+    if (worker->cpu != -1 && cpu_pin(worker->cpu) == -1) {
+        perror("cpu_pin");
         exit(EXIT_FAILURE);
     }
 
-    io_fuzzer_set_error_handler(default_error_handler);
-    io_fuzzer_t *io_fuzzer = io_fuzzer_create(ports, num_ports);
-    if (io_fuzzer == NULL) {
-        perror("io_fuzzer_create");
-        goto err;
+    if (worker->priority != 0 && cpu_set_fifo(worker->priority) == -1) {
+        perror("cpu_set_fifo");
+        exit(EXIT_FAILURE);
     }
 
-    io_fuzzer_set_log_handler(io_fuzzer, default_log_handler);
-    io_fuzzer_set_log_stream(io_fuzzer, stream);
-    if (generate) {
-        srandom(seed);
-        for (;;) {
-            uint8_t buf[IO_FUZZER_MAX_INPUT];
-            random_buf(buf, sizeof(buf));
-            FILE *stream = fmemopen(buf, sizeof(buf), "r");
-            if (stream == NULL) {
-                perror("fmemopen");
-                goto err;
-            }
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    worker->involuntary_switches = -usage.ru_nivcsw;
+    clock_gettime(CLOCK_MONOTONIC, &worker->start);
+}
 
-            io_fuzzer_iterate(io_fuzzer, stream);
-            fclose(stream);
+void
+worker_end(worker_t *restrict worker)
+{
+    clock_gettime(CLOCK_MONOTONIC, &worker->end);
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    worker->involuntary_switches += usage.ru_nivcsw;
+}
+
+void
+worker_replay(
+        worker_t *restrict worker, const replay_t *restrict replay, uint64_t repeat, replay_timing_t *restrict timing)
+{
+    size_t num_operations = 0;
+    const io_fuzzer_operation_t *operations = replay_get_operations(replay, &num_operations);
+    uint64_t *gaps = NULL;
+    if (timing->scale > 0 && num_operations != 0) {
+        gaps = (uint64_t *)calloc(num_operations, sizeof(*gaps));
+        if (gaps == NULL) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
         }
-    } else {
-        if (argv[optind] != NULL) {
-            input = argv[optind];
+
+        const uint64_t *times = replay_get_times(replay);
+        for (size_t j = 1; j < num_operations; ++j) {
+            uint64_t gap = (times[j] > times[j - 1]) ? (times[j] - times[j - 1]) : 0;
+            gaps[j] = tsc_from_ns(worker->tsc_frequency, gap * timing->scale);
         }
+    }
 
-        FILE *stream = stdin;
-        if (input != NULL) {
-            FILE *stream = fopen(input, "r");
-            if (stream == NULL) {
-                perror("fopen");
-                exit(EXIT_FAILURE);
+    worker_begin(worker);
+    for (uint64_t i = 0; (repeat == 0 || i < repeat) && !stop; ++i) {
+        uint64_t previous = 0;
+        for (size_t j = 0; j < num_operations && !stop; ++j) {
+            if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+                io_fuzzer_log_operation(worker->io_fuzzer, &operations[j]);
+            }
+
+            if (gaps != NULL) {
+                /* Each gap starts when the previous operation was performed, so a late operation does not shorten the
+                 * gaps after it. */
+                uint64_t now = tsc_read();
+                if (j != 0) {
+                    uint64_t deadline = previous + gaps[j];
+                    if (now > deadline) {
+                        ++timing->num_late;
+                    } else {
+                        tsc_wait_until(deadline);
+                        now = tsc_read();
+                    }
+
+                    uint64_t error = now - deadline;
+                    ++timing->num_gaps;
+                    timing->recorded += gaps[j];
+                    timing->replayed += now - previous;
+                    timing->total_error += error;
+                    if (error > timing->max_error) {
+                        timing->max_error = error;
+                    }
+                }
+
+                previous = now;
             }
+
+            io_fuzzer_execute(worker->io_fuzzer, &operations[j]);
+            io_fuzzer_log_responses(worker->io_fuzzer);
+        }
+
+        ++worker->iterations;
+    }
+
+    worker_end(worker);
+    free(gaps);
+}
+
+void *
+worker_run(void *arg)
+{
+    worker_t *worker = (worker_t *)arg;
+    uint8_t buf[IO_FUZZER_MAX_INPUT];
+    worker_begin(worker);
+    while (!stop) {
+        random_buf(&worker->random_data, buf, sizeof(buf));
+        FILE *stream = fmemopen(buf, sizeof(buf), "r");
+        if (stream == NULL) {
+            perror("fmemopen");
+            exit(EXIT_FAILURE);
         }
 
-        io_fuzzer_iterate(io_fuzzer, stream);
+        io_fuzzer_iterate(worker->io_fuzzer, stream);
         fclose(stream);
+        ++worker->iterations;
     }
 
-    io_fuzzer_destroy(io_fuzzer);
-    fclose(stream);
-    free(ports);
-    exit(EXIT_SUCCESS);
+    worker_end(worker);
+    return NULL;
+}
+
+void
+worker_sequence(void *arg)
+{
+    sequence_t *sequence = (sequence_t *)arg;
+    worker_t *worker = sequence->worker;
+    io_fuzzer_operation_t operation = {.string = sequence->string};
+    while (!stop) {
+        random_buf(&worker->random_data, sequence->buf, IO_FUZZER_MAX_INPUT);
+        FILE *stream = fmemopen(sequence->buf, IO_FUZZER_MAX_INPUT, "r");
+        if (stream == NULL) {
+            perror("fmemopen");
+            exit(EXIT_FAILURE);
+        }
+
+        io_fuzzer_decode(worker->io_fuzzer, stream, &operation);
+
+        /* Reads wait for the masked value read to be a value drawn from the input, as when polling a status port. */
+        switch (operation.function) {
+        case IO_FUZZER_IO_READ16: {
+            uint16_t mask = input_read16(stream);
+            fiber_wait16(worker->io_fuzzer, operation.port, mask, input_read16(stream) & mask, worker->max_polls, NULL);
+            break;
+        }
+
+        case IO_FUZZER_IO_READ32: {
+            uint32_t mask = input_read32(stream);
+            fiber_wait32(worker->io_fuzzer, operation.port, mask, input_read32(stream) & mask, worker->max_polls, NULL);
+            break;
+        }
+
+        case IO_FUZZER_IO_READ8: {
+            uint8_t mask = input_read8(stream);
+            fiber_wait8(worker->io_fuzzer, operation.port, mask, input_read8(stream) & mask, worker->max_polls, NULL);
+            break;
+        }
+
+        default:
+            fiber_execute(worker->io_fuzzer, &operation);
+            fiber_yield();
+            break;
+        }
+
+        fclose(stream);
+        ++worker->iterations;
+    }
+}
+
+void *
+worker_fibers(void *arg)
+{
+    worker_t *worker = (worker_t *)arg;
+    fiber_scheduler_t *scheduler = fiber_scheduler_create();
+    if (scheduler == NULL) {
+        perror("fiber_scheduler_create");
+        exit(EXIT_FAILURE);
+    }
+
+    sequence_t *sequences = (sequence_t *)calloc(worker->num_fibers, sizeof(*sequences));
+    uint8_t *buffers = (uint8_t *)malloc(worker->num_fibers * (IO_FUZZER_MAX_INPUT + IO_FUZZER_MAX_STRING));
+    if (sequences == NULL || buffers == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < worker->num_fibers; ++i) {
+        sequence_t *sequence = &sequences[i];
+        sequence->worker = worker;
+        sequence->buf = buffers + (i * (IO_FUZZER_MAX_INPUT + IO_FUZZER_MAX_STRING));
+        sequence->string = sequence->buf + IO_FUZZER_MAX_INPUT;
+        if (fiber_spawn(scheduler, worker_sequence, sequence, 0) == -1) {
+            perror("fiber_spawn");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    worker_begin(worker);
+    fiber_scheduler_run(scheduler);
+    worker_end(worker);
+    fiber_scheduler_destroy(scheduler);
+    free(buffers);
+    free(sequences);
+    return NULL;
+}
+
+void *
+worker_race(void *arg)
+{
+    worker_t *worker = (worker_t *)arg;
+    uint8_t buf[IO_FUZZER_MAX_INPUT];
+    worker_begin(worker);
+    for (uint64_t round = 0; !stop; ++round) {
+        for (size_t i = 0; i < worker->num_operations; ++i) {
+            random_buf(&worker->random_data, buf, sizeof(buf));
+            FILE *stream = fmemopen(buf, sizeof(buf), "r");
+            if (stream == NULL) {
+                perror("fmemopen");
+                exit(EXIT_FAILURE);
+            }
+
+            io_fuzzer_decode(worker->io_fuzzer, stream, &worker->operations[i]);
+            fclose(stream);
+        }
+
+        int32_t number = 0;
+        random_r(&worker->random_data, &number);
+        uint64_t skew = number % (worker->skew + 1);
+        if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            trace_record_t record;
+            memset(&record, 0, sizeof(record));
+            record.function = TRACE_FUNCTION_RACE;
+            record.payload = round;
+            record.value = skew;
+            record.count = worker->num_operations;
+            io_fuzzer_log(worker->io_fuzzer, &record);
+            for (size_t i = 0; i < worker->num_operations; ++i) {
+                io_fuzzer_log_operation(worker->io_fuzzer, &worker->operations[i]);
+            }
+        }
+
+        uint64_t release = 0;
+        if (barrier_wait(&barrier, &release) == -1) {
+            break;
+        }
+
+        tsc_wait_until(release + tsc_from_ns(worker->tsc_frequency, skew));
+        for (size_t i = 0; i < worker->num_operations; ++i) {
+            io_fuzzer_execute(worker->io_fuzzer, &worker->operations[i]);
+        }
+
+        io_fuzzer_log_responses(worker->io_fuzzer);
+
+        worker->iterations += worker->num_operations;
+    }
+
+    worker_end(worker);
+    return NULL;
+}
+
+void *
+worker_generate(void *arg)
+{
+    worker_t *worker = (worker_t *)arg;
+    uint8_t buf[IO_FUZZER_MAX_INPUT];
+    worker_begin(worker);
+    for (uint64_t sequence = 0; !stop; ++sequence) {
+        void *slot = NULL;
+        while ((slot = ring_acquire(worker->ring)) == NULL) {
+            if (stop) {
+                goto out;
+            }
+
+            asm volatile("pause");
+        }
+
+        program_t *program = program_init(slot, PIPELINE_MAX_OPERATIONS, PIPELINE_CAPACITY);
+        program->sequence = sequence;
+        io_fuzzer_operation_t *operation = NULL;
+        while ((operation = program_reserve(program)) != NULL) {
+            random_buf(&worker->random_data, buf, sizeof(buf));
+            FILE *stream = fmemopen(buf, sizeof(buf), "r");
+            if (stream == NULL) {
+                perror("fmemopen");
+                exit(EXIT_FAILURE);
+            }
+
+            io_fuzzer_decode(worker->io_fuzzer, stream, operation);
+            fclose(stream);
+            program_commit(program);
+        }
+
+        if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            trace_record_t record;
+            memset(&record, 0, sizeof(record));
+            record.function = TRACE_FUNCTION_PROGRAM;
+            record.payload = sequence;
+            record.count = program->num_operations;
+            io_fuzzer_log(worker->io_fuzzer, &record);
+            for (size_t i = 0; i < program->num_operations; ++i) {
+                io_fuzzer_log_operation(worker->io_fuzzer, &program->operations[i]);
+            }
+        }
+
+        ring_produce(worker->ring);
+        worker->iterations += program->num_operations;
+    }
+
+out:
+    worker_end(worker);
+    return NULL;
+}
+
+void *
+worker_execute(void *arg)
+{
+    worker_t *worker = (worker_t *)arg;
+    worker_begin(worker);
+    for (size_t i = 0;; i = (i + 1) % worker->num_generators) {
+        ring_t *ring = worker->generators[i].ring;
+        program_t *program = (program_t *)ring_peek(ring);
+        if (program == NULL) {
+            uint64_t begin = tsc_read();
+            while ((program = (program_t *)ring_peek(ring)) == NULL && !stop) {
+                asm volatile("pause");
+            }
+
+            worker->idle += tsc_read() - begin;
+            if (program == NULL) {
+                break;
+            }
+        }
+
+        if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            trace_record_t record;
+            memset(&record, 0, sizeof(record));
+            record.function = TRACE_FUNCTION_EXECUTE;
+            record.payload = program->sequence;
+            record.value = i;
+            record.count = program->num_operations;
+            io_fuzzer_log(worker->io_fuzzer, &record);
+        }
+
+        for (size_t j = 0; j < program->num_operations; ++j) {
+            io_fuzzer_execute(worker->io_fuzzer, &program->operations[j]);
+        }
+
+        io_fuzzer_log_responses(worker->io_fuzzer);
+
+        worker->iterations += program->num_operations;
+        ring_consume(ring);
+    }
+
+    worker_end(worker);
+    return NULL;
+}
+
+void
+print_latency(FILE *restrict stream, const worker_t *worker)
+{
+    uint64_t num_operations = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+    io_fuzzer_get_latency(worker->io_fuzzer, &num_operations, &total, &max);
+    if (num_operations != 0) {
+        fprintf(stream, ", %.0f ns mean latency, %llu ns max latency",
+                (double)tsc_clock_to_ns(&tsc_clock, total) / num_operations,
+                (unsigned long long)tsc_clock_to_ns(&tsc_clock, max));
+    }
+}
+
+void
+print_executor_summary(FILE *restrict stream, const worker_t *executor)
+{
+    double seconds =
+            (executor->end.tv_sec - executor->start.tv_sec) + (executor->end.tv_nsec - executor->start.tv_nsec) / 1e9;
+    double idle = tsc_to_ns(executor->tsc_frequency, executor->idle) / 1e9;
+    fprintf(stream,
+            "executor: cpu %d, %llu iterations, %.1f iterations/s, %.3f s idle (%.1f%%), %ld involuntary context "
+            "switches",
+            executor->cpu, (unsigned long long)executor->iterations, seconds > 0 ? executor->iterations / seconds : 0,
+            idle, seconds > 0 ? (100 * idle / seconds) : 0, executor->involuntary_switches);
+    print_latency(stream, executor);
+    fputc('\n', stream);
+}
+
+void
+print_summary(FILE *restrict stream, const worker_t *workers, size_t num_workers)
+{
+    uint64_t iterations = 0;
+    long involuntary_switches = 0;
+    double elapsed = 0;
+    for (size_t i = 0; i < num_workers; ++i) {
+        const worker_t *worker = &workers[i];
+        double seconds =
+                (worker->end.tv_sec - worker->start.tv_sec) + (worker->end.tv_nsec - worker->start.tv_nsec) / 1e9;
+        fprintf(stream,
+                "worker %zu: cpu %d, seed %lu, %llu iterations, %.1f iterations/s, %ld involuntary context switches",
+                worker->id, worker->cpu, worker->seed, (unsigned long long)worker->iterations,
+                seconds > 0 ? worker->iterations / seconds : 0, worker->involuntary_switches);
+        print_latency(stream, worker);
+        if (worker->channel != NULL) {
+            fprintf(stream, ", %llu dropped records", (unsigned long long)worker->drops);
+        }
+
+        if (worker->commit.policy != COMMIT_NONE) {
+            double syncing = worker->commit.time / 1e9;
+            fprintf(stream, ", %llu syncs, %.3f s syncing (%.1f%%)", (unsigned long long)worker->commit.num_commits,
+                    syncing, seconds > 0 ? (100 * syncing / seconds) : 0);
+        }
+
+        if (worker->segments != NULL) {
+            fprintf(stream, ", %llu segments", (unsigned long long)segment_writer_get_num_segments(worker->segments));
+        }
+
+        fputc('\n', stream);
+        iterations += worker->iterations;
+        involuntary_switches += worker->involuntary_switches;
+        if (seconds > elapsed) {
+            elapsed = seconds;
+        }
+    }
+
+    fprintf(stream, "total: %zu workers, %llu iterations, %.1f iterations/s, %ld involuntary context switches\n",
+            num_workers, (unsigned long long)iterations, elapsed > 0 ? iterations / elapsed : 0, involuntary_switches);
+}
+
+void
+print_replay_summary(FILE *restrict stream, const worker_t *worker, const replay_t *replay,
+        const replay_timing_t *restrict timing)
+{
+    size_t num_operations = 0;
+    replay_get_operations(replay, &num_operations);
+    uint64_t num_executed = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+    io_fuzzer_get_latency(worker->io_fuzzer, &num_executed, &total, &max);
+    double seconds = (worker->end.tv_sec - worker->start.tv_sec) + (worker->end.tv_nsec - worker->start.tv_nsec) / 1e9;
+    fprintf(stream,
+            "replay: %zu operations, %llu repetitions, %llu operations performed, %.1f operations/s, %ld involuntary "
+            "context switches",
+            num_operations, (unsigned long long)worker->iterations, (unsigned long long)num_executed,
+            seconds > 0 ? num_executed / seconds : 0, worker->involuntary_switches);
+    print_latency(stream, worker);
+    fputc('\n', stream);
+    if (timing->scale > 0) {
+        double recorded = tsc_clock_to_ns(&tsc_clock, timing->recorded) / 1e6;
+        double replayed = tsc_clock_to_ns(&tsc_clock, timing->replayed) / 1e6;
+        fprintf(stream,
+                "timing: scale %g, %.3f ms recorded, %.3f ms replayed, %.3f ms drift (%.2f%%), %.0f ns mean gap "
+                "error, %llu ns max gap error, %llu of %llu operations late\n",
+                timing->scale, recorded, replayed, replayed - recorded,
+                recorded > 0 ? (100 * (replayed - recorded) / recorded) : 0,
+                timing->num_gaps > 0 ? (double)tsc_clock_to_ns(&tsc_clock, timing->total_error) / timing->num_gaps : 0,
+                (unsigned long long)tsc_clock_to_ns(&tsc_clock, timing->max_error),
+                (unsigned long long)timing->num_late, (unsigned long long)timing->num_gaps);
+    }
+}
+
+void
+destroy_workers(worker_t *workers, size_t num_workers, FILE *restrict stream)
+{
+    for (size_t i = 0; i < num_workers; ++i) {
+        io_fuzzer_destroy(workers[i].io_fuzzer);
+        if (workers[i].log_stream != NULL) {
+            fflush(workers[i].log_stream);
+            commit_sync(&workers[i].commit);
+        }
+
+        trace_writer_destroy(workers[i].writer);
+        blob_buffer_destroy(workers[i].blob_buffer);
+
+        segment_writer_destroy(workers[i].segments);
+        ring_destroy(workers[i].ring);
+        if (workers[i].operations != NULL) {
+            free(workers[i].operations[0].string);
+            free(workers[i].operations);
+        }
+
+        if (workers[i].log_stream != NULL && workers[i].log_stream != stream) {
+            fclose(workers[i].log_stream);
+        }
+    }
+
+    free(workers);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_ASYNC_LOG = CHAR_MAX + 1,
+        OPT_BLOB_STORE,
+        OPT_CAPTURE_READS,
+        OPT_CPU,
+        OPT_EXCLUDE_OUTPUT_DEVICE,
+        OPT_EXPORT,
+        OPT_EXPORT_INTERVAL,
+        OPT_FIBER_POLLS,
+        OPT_FIBERS,
+        OPT_FLIGHT_RECORDER,
+        OPT_FLIGHT_RECORDER_DEVICE,
+        OPT_LOG_OVERFLOW,
+        OPT_LOG_PORT,
+        OPT_LOG_UART,
+        OPT_MLOCK,
+        OPT_PIPELINE,
+        OPT_RACE_LENGTH,
+        OPT_RECOVER,
+        OPT_REPEAT,
+        OPT_REPLAY,
+        OPT_REPLAY_RANGE,
+        OPT_REPLAY_TIMING,
+        OPT_SCHED_FIFO,
+        OPT_SEGMENT_SIZE,
+        OPT_SEGMENTS,
+        OPT_SKEW,
+        OPT_SYNC,
+        OPT_VERSION,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"async-log",              no_argument,       NULL, OPT_ASYNC_LOG              },
+        {"blob-store",             required_argument, NULL, OPT_BLOB_STORE             },
+        {"capture-reads",          optional_argument, NULL, OPT_CAPTURE_READS          },
+        {"cpu",                    required_argument, NULL, OPT_CPU                    },
+        {"debug",                  no_argument,       NULL, 'd'                        },
+        {"exclude-output-device",  no_argument,       NULL, OPT_EXCLUDE_OUTPUT_DEVICE  },
+        {"export",                 required_argument, NULL, OPT_EXPORT                 },
+        {"export-interval",        required_argument, NULL, OPT_EXPORT_INTERVAL        },
+        {"fiber-polls",            required_argument, NULL, OPT_FIBER_POLLS            },
+        {"fibers",                 required_argument, NULL, OPT_FIBERS                 },
+        {"flight-recorder",        required_argument, NULL, OPT_FLIGHT_RECORDER        },
+        {"flight-recorder-device", required_argument, NULL, OPT_FLIGHT_RECORDER_DEVICE },
+        {"format",                 required_argument, NULL, 'f'                        },
+        {"generate",               no_argument,       NULL, 'g'                        },
+        {"help",                   no_argument,       NULL, 'h'                        },
+        {"jobs",                   required_argument, NULL, 'j'                        },
+        {"log-overflow",           required_argument, NULL, OPT_LOG_OVERFLOW           },
+        {"log-port",               required_argument, NULL, OPT_LOG_PORT               },
+        {"log-uart",               required_argument, NULL, OPT_LOG_UART               },
+        {"mlock",                  no_argument,       NULL, OPT_MLOCK                  },
+        {"output",                 required_argument, NULL, 'o'                        },
+        {"pipeline",               required_argument, NULL, OPT_PIPELINE               },
+        {"ports",                  required_argument, NULL, 'p'                        },
+        {"quiet",                  no_argument,       NULL, 'q'                        },
+        {"race",                   no_argument,       NULL, 'r'                        },
+        {"race-length",            required_argument, NULL, OPT_RACE_LENGTH            },
+        {"recover",                no_argument,       NULL, OPT_RECOVER                },
+        {"repeat",                 required_argument, NULL, OPT_REPEAT                 },
+        {"replay",                 required_argument, NULL, OPT_REPLAY                 },
+        {"replay-range",           required_argument, NULL, OPT_REPLAY_RANGE           },
+        {"replay-timing",          optional_argument, NULL, OPT_REPLAY_TIMING          },
+        {"sched-fifo",             optional_argument, NULL, OPT_SCHED_FIFO             },
+        {"seed",                   required_argument, NULL, 's'                        },
+        {"segment-size",           required_argument, NULL, OPT_SEGMENT_SIZE           },
+        {"segments",               required_argument, NULL, OPT_SEGMENTS               },
+        {"skew",                   required_argument, NULL, OPT_SKEW                   },
+        {"sync",                   required_argument, NULL, OPT_SYNC                   },
+        {"timeout",                required_argument, NULL, 't'                        },
+        {"verbose",                no_argument,       NULL, 'v'                        },
+        {"version",                no_argument,       NULL, OPT_VERSION                },
+        {NULL,                     0,                 NULL, 0                          }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    int async_log = 0;
+    char *blob_filename = NULL;
+    int capture = IO_FUZZER_CAPTURE_NONE;
+    int *cpus = NULL;
+    size_t num_cpus = 0;
+    int exclude_output_device = 0;
+    char *export_directory = NULL;
+    unsigned long export_interval = EXPORT_INTERVAL_MS;
+    unsigned long fiber_polls = FIBER_MAX_POLLS;
+    size_t fibers = 0;
+    uint64_t flight_recorder_address = 0;
+    uint64_t flight_recorder_size = 0;
+    char *flight_recorder_device = "/dev/mem";
+    char *format = NULL;
+    int generate = 0;
+    char *input = NULL;
+    size_t jobs = 1;
+    int log_overflow = LOGGER_OVERFLOW_BLOCK;
+    long log_port = -1;
+    int log_port_type = CONSOLE_DEBUGCON;
+    int lock_memory = 0;
+    char *output = NULL;
+    size_t pipeline = 0;
+    int *ports = NULL;
+    size_t num_ports = 0;
+    int race = 0;
+    size_t race_length = 4;
+    int recover = 0;
+    uint64_t repeat = 1;
+    char *replay_filename = NULL;
+    uint64_t replay_first = 0;
+    uint64_t replay_last = UINT64_MAX;
+    replay_timing_t replay_timing = {.scale = 0};
+    int sched_fifo = 0;
+    unsigned long seed = 1;
+    uint64_t segment_size = 0;
+    size_t max_segments = 0;
+    uint64_t skew = 1000;
+    int sync_policy = COMMIT_EVERY;
+    uint64_t sync_interval = 0;
+    int log_level = IO_FUZZER_LOG_NORMAL;
+    int timeout = 5;
+    while ((c = getopt_long(argc, argv, "df:ghj:o:p:qrs:t:v", longopts, &longindex)) != -1) {
+        switch (c) {
+        case OPT_ASYNC_LOG:
+            async_log = 1;
+            break;
+
+        case OPT_BLOB_STORE:
+            blob_filename = optarg;
+            break;
+
+        case OPT_CAPTURE_READS:
+            if (optarg == NULL) {
+                capture = IO_FUZZER_CAPTURE_READS;
+            } else if (strcmp(optarg, "full") == 0) {
+                capture = IO_FUZZER_CAPTURE_STRINGS;
+            } else {
+                fprintf(stderr, "%s: invalid capture mode -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_CPU:
+            free(cpus);
+            if (string_split_range(optarg, ",", CPU_SETSIZE - 1, &cpus, &num_cpus) == -1) {
+                perror("getlist");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'd':
+            log_level = IO_FUZZER_LOG_DEBUG;
+            break;
+
+        case OPT_EXCLUDE_OUTPUT_DEVICE:
+            exclude_output_device = 1;
+            break;
+
+        case OPT_EXPORT:
+            export_directory = optarg;
+            break;
+
+        case OPT_EXPORT_INTERVAL:
+            errno = 0;
+            export_interval = strtoul(optarg, NULL, 0);
+            if (errno != 0 || export_interval == 0) {
+                fprintf(stderr, "%s: invalid export interval -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_FIBER_POLLS:
+            errno = 0;
+            fiber_polls = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            /* The sequences only check for a stop between operations, so every wait must end. */
+            if (fiber_polls == 0) {
+                fprintf(stderr, "%s: invalid number of polls -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_FIBERS:
+            errno = 0;
+            fibers = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (fibers == 0) {
+                fprintf(stderr, "%s: invalid number of fibers -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_FLIGHT_RECORDER: {
+            char *end = NULL;
+            if (parse_size(optarg, &end, &flight_recorder_size) == -1 || *end != '@' ||
+                    parse_size(end + 1, &end, &flight_recorder_address) == -1 || *end != '\0' ||
+                    flight_recorder_size == 0) {
+                fprintf(stderr, "%s: invalid flight recorder region -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+        }
+
+        case OPT_FLIGHT_RECORDER_DEVICE:
+            flight_recorder_device = optarg;
+            break;
+
+        case 'f':
+            if (strcmp(optarg, "binary") != 0 && strcmp(optarg, "json") != 0) {
+                fprintf(stderr, "%s: invalid format -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            format = optarg;
+            break;
+
+        case 'g':
+            generate = 1;
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'j':
+            errno = 0;
+            jobs = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (jobs == 0) {
+                fprintf(stderr, "%s: invalid number of jobs -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_LOG_OVERFLOW:
+            if (strcmp(optarg, "block") == 0) {
+                log_overflow = LOGGER_OVERFLOW_BLOCK;
+            } else if (strcmp(optarg, "drop") == 0) {
+                log_overflow = LOGGER_OVERFLOW_DROP;
+            } else if (strcmp(optarg, "drop-oldest") == 0) {
+                log_overflow = LOGGER_OVERFLOW_DROP_OLDEST;
+            } else {
+                fprintf(stderr, "%s: invalid overflow policy -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            async_log = 1;
+            break;
+
+        case OPT_LOG_PORT:
+        case OPT_LOG_UART:
+            errno = 0;
+            log_port = strtol(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtol");
+                exit(EXIT_FAILURE);
+            }
+
+            log_port_type = (c == OPT_LOG_UART) ? CONSOLE_UART : CONSOLE_DEBUGCON;
+            if (log_port < 0 || log_port > ((log_port_type == CONSOLE_UART) ? (MAX_PORTS - CONSOLE_UART_NUM_PORTS)
+                                                                            : (MAX_PORTS - 1))) {
+                fprintf(stderr, "%s: invalid port -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_MLOCK:
+            lock_memory = 1;
+            break;
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'p':
+            if (string_split_range(optarg, ",", MAX_PORTS, &ports, &num_ports) == -1) {
+                perror("getlist");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_PIPELINE:
+            errno = 0;
+            pipeline = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (pipeline == 0) {
+                fprintf(stderr, "%s: invalid number of generators -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'q':
+            log_level = IO_FUZZER_LOG_QUIET;
+            break;
+
+        case 'r':
+            race = 1;
+            break;
+
+        case OPT_RACE_LENGTH:
+            errno = 0;
+            race_length = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (race_length == 0) {
+                fprintf(stderr, "%s: invalid race length -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_RECOVER:
+            recover = 1;
+            break;
+
+        case OPT_REPEAT:
+            errno = 0;
+            repeat = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_REPLAY:
+            replay_filename = optarg;
+            break;
+
+        case OPT_REPLAY_TIMING:
+            replay_timing.scale = 1;
+            if (optarg != NULL) {
+                char *end = NULL;
+                errno = 0;
+                replay_timing.scale = strtod(optarg, &end);
+                if (errno != 0 || end == optarg || *end != '\0' || !(replay_timing.scale > 0)) {
+                    fprintf(stderr, "%s: invalid replay timing scale -- '%s'\n", argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            break;
+
+        case OPT_REPLAY_RANGE: {
+            char *end = NULL;
+            errno = 0;
+            replay_first = strtoull(optarg, &end, 0);
+            if (errno == 0 && end != optarg && *end == '-') {
+                const char *last = end + 1;
+                replay_last = strtoull(last, &end, 0);
+                if (end == last) {
+                    errno = EINVAL;
+                }
+            }
+
+            if (errno != 0 || end == optarg || *end != '\0' || replay_first > replay_last) {
+                fprintf(stderr, "%s: invalid replay range -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+        }
+
+        case 's':
+            errno = 0;
+            seed = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SCHED_FIFO:
+            sched_fifo = 1;
+            if (optarg != NULL) {
+                errno = 0;
+                sched_fifo = strtoul(optarg, NULL, 0);
+                if (errno != 0) {
+                    perror("strtoul");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (sched_fifo < 1 || sched_fifo > 99) {
+                    fprintf(stderr, "%s: invalid priority -- '%s'\n", argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            break;
+
+        case OPT_SEGMENT_SIZE: {
+            char *end = NULL;
+            if (parse_size(optarg, &end, &segment_size) == -1 || *end != '\0' || segment_size == 0 ||
+                    segment_size % SEGMENT_ALIGNMENT != 0) {
+                fprintf(stderr, "%s: invalid segment size -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+        }
+
+        case OPT_SEGMENTS:
+            errno = 0;
+            max_segments = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SKEW:
+            errno = 0;
+            skew = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            /* The skew is drawn with random_r(), which returns 31 bits. */
+            if (skew > INT32_MAX) {
+                fprintf(stderr, "%s: invalid skew -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SYNC:
+            if (strcmp(optarg, "every") == 0) {
+                sync_policy = COMMIT_EVERY;
+            } else if (strcmp(optarg, "none") == 0) {
+                sync_policy = COMMIT_NONE;
+            } else {
+                char *end = NULL;
+                errno = 0;
+                sync_interval = strtoull(optarg, &end, 0);
+                if (errno != 0) {
+                    perror("strtoull");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (end == optarg || sync_interval == 0 || (*end != '\0' && strcmp(end, "ms") != 0)) {
+                    fprintf(stderr, "%s: invalid sync policy -- '%s'\n", argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                sync_policy = (*end == '\0') ? COMMIT_RECORDS : COMMIT_INTERVAL;
+                if (sync_policy == COMMIT_INTERVAL) {
+                    sync_interval *= 1000000;
+                }
+            }
+
+            break;
+
+        case 't':
+            errno = 0;
+            timeout = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'v':
+            log_level = IO_FUZZER_LOG_VERBOSE;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    io_fuzzer_set_log_level(log_level);
+    if (recover) {
+        if (flight_recorder_size == 0) {
+            fprintf(stderr, "%s: recovery requires a flight recorder\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        recorder_t *recorder = recorder_open(flight_recorder_device, flight_recorder_address, flight_recorder_size);
+        if (recorder == NULL) {
+            perror("recorder_open");
+            exit(EXIT_FAILURE);
+        }
+
+        size_t num_rings = recorder_get_num_rings(recorder);
+        for (size_t i = 0; i < num_rings; ++i) {
+            FILE *stream = stdout;
+            if (output != NULL) {
+                char filename[PATH_MAX];
+                snprintf(filename, sizeof(filename), (num_rings > 1) ? "%s.%zu" : "%s", output, i);
+                stream = fopen(filename, "a+");
+                if (stream == NULL) {
+                    perror("fopen");
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            uint64_t num_records = recorder_print_json(recorder, i, stream);
+            if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+                const recorder_ring_t *ring = recorder_get_ring(recorder, i);
+                fprintf(stderr, "worker %u: seed %llu, %llu records logged, %llu records recovered\n",
+                        ring->header.worker, (unsigned long long)ring->header.seed,
+                        (unsigned long long)atomic_load(&ring->count), (unsigned long long)num_records);
+            }
+
+            if (stream != stdout) {
+                fclose(stream);
+            }
+        }
+
+        recorder_destroy(recorder);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (replay_timing.scale > 0 && replay_filename == NULL) {
+        fprintf(stderr, "%s: replay timing requires replay mode\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (replay_filename != NULL && (generate || jobs > 1)) {
+        fprintf(stderr, "%s: replay mode requires a single job and no generate mode\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (jobs > 1 && !generate) {
+        fprintf(stderr, "%s: multiple jobs require generate mode\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (race && (!generate || jobs < 2 || num_ports == 0)) {
+        fprintf(stderr, "%s: race mode requires generate mode, multiple jobs, and a list of ports\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (pipeline > 0 && (!generate || jobs > 1 || race)) {
+        fprintf(stderr, "%s: pipeline mode requires generate mode and a single job\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (fibers > 0 && (!generate || race || pipeline > 0)) {
+        fprintf(stderr, "%s: fiber mode requires generate mode and no race or pipeline mode\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (segment_size != 0 && output == NULL) {
+        fprintf(stderr, "%s: segments require an output file\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (export_directory != NULL && (output == NULL || segment_size != 0)) {
+        fprintf(stderr, "%s: exporting requires an output file without segments\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (capture == IO_FUZZER_CAPTURE_STRINGS && blob_filename == NULL) {
+        fprintf(stderr, "%s: capturing the strings read requires a blob store\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (log_port != -1 && output != NULL) {
+        fprintf(stderr, "%s: the log port and the output file are mutually exclusive\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    int binary = (format != NULL) ? (strcmp(format, "binary") == 0) : (output != NULL || log_port != -1);
+    if (binary && output == NULL && (jobs > 1 || pipeline > 0)) {
+        fprintf(stderr, "%s: binary output of multiple threads requires an output file\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (log_port != -1) {
+        int last = log_port + ((log_port_type == CONSOLE_UART) ? (CONSOLE_UART_NUM_PORTS - 1) : 0);
+        if (exclude_ports(&ports, &num_ports, log_port, last) == -1) {
+            perror("exclude_ports");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    const char *sinks[] = {output, blob_filename, export_directory};
+    for (size_t i = 0; i < sizeof(sinks) / sizeof(*sinks); ++i) {
+        if (sinks[i] == NULL) {
+            continue;
+        }
+
+        device_io_range_t ranges[MAX_IO_RANGES];
+        ssize_t num_ranges = device_get_io_ranges(sinks[i], ranges, MAX_IO_RANGES);
+        if (num_ranges == -1) {
+            io_fuzzer_message(IO_FUZZER_LOG_VERBOSE, "%s: could not find the device of %s: %s\n", argv[0], sinks[i],
+                    strerror(errno));
+            continue;
+        }
+
+        for (ssize_t j = 0; j < num_ranges; ++j) {
+            const device_io_range_t *range = &ranges[j];
+            if (exclude_output_device) {
+                io_fuzzer_message(IO_FUZZER_LOG_VERBOSE, "%s: excluding ports %#x-%#x of %s (PCI %s)\n", argv[0],
+                        range->first, range->last, sinks[i], range->pci);
+                if (exclude_ports(&ports, &num_ports, range->first, range->last) == -1) {
+                    perror("exclude_ports");
+                    exit(EXIT_FAILURE);
+                }
+            } else if (ports_overlap(ports, num_ports, range->first, range->last)
+                    && io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+                fprintf(stderr,
+                        "%s: warning: %s is stored on PCI %s, whose ports %#x-%#x are fuzzed (see "
+                        "--exclude-output-device, --export, and --log-port)\n",
+                        argv[0], sinks[i], range->pci, range->first, range->last);
+            }
+        }
+    }
+
+    uint64_t tsc_frequency = tsc_calibrate();
+    if (tsc_frequency == 0) {
+        fprintf(stderr, "%s: could not calibrate the time-stamp counter\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    tsc_clock_init(&tsc_clock, tsc_frequency);
+    io_fuzzer_message(IO_FUZZER_LOG_VERBOSE, "%s: TSC frequency %llu Hz\n", argv[0], (unsigned long long)tsc_frequency);
+    if (race) {
+        barrier_init(&barrier, jobs, tsc_from_ns(tsc_frequency, RACE_MARGIN_NS));
+    }
+
+    size_t num_workers = (pipeline > 0) ? (pipeline + 1) : jobs;
+    if (cpus == NULL && num_workers > 1) {
+        if (cpu_get_available(&cpus, &num_cpus) == -1) {
+            perror("cpu_get_available");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (cpus != NULL) {
+        if (num_cpus < num_workers) {
+            fprintf(stderr, "%s: not enough CPUs for %zu threads (%zu available)\n", argv[0], num_workers, num_cpus);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    FILE *stream = stdout;
+    if (output != NULL && num_workers == 1 && segment_size == 0) {
+        stream = fopen(output, "a+");
+        if (stream == NULL) {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (iopl(3) == -1) {
+        perror("iopl");
+        exit(EXIT_FAILURE);
+    }
+
+    io_fuzzer_set_error_handler(default_error_handler);
+    console_t *console = NULL;
+    if (log_port != -1) {
+        console = console_create(log_port, log_port_type);
+        if (console == NULL) {
+            perror("console_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t num_loggers = (pipeline > 0) ? pipeline : jobs;
+    recorder_t *recorder = NULL;
+    if (flight_recorder_size != 0) {
+        recorder = recorder_create(flight_recorder_device, flight_recorder_address, flight_recorder_size, num_workers);
+        if (recorder == NULL) {
+            perror("recorder_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int blob_fd = -1;
+    blob_store_t *blob_store = NULL;
+    committer_t *committer = NULL;
+    exporter_t *exporter = NULL;
+    if (blob_filename != NULL) {
+        blob_fd = open(blob_filename, O_RDWR | O_CREAT, 0666);
+        if (blob_fd == -1) {
+            perror("open");
+            exit(EXIT_FAILURE);
+        }
+
+        blob_store = blob_store_create(blob_fd);
+        if (blob_store == NULL) {
+            perror("blob_store_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    replay_t *replay = NULL;
+    if (replay_filename != NULL) {
+        FILE *replay_stream = fopen(replay_filename, "r");
+        if (replay_stream == NULL) {
+            perror(replay_filename);
+            exit(EXIT_FAILURE);
+        }
+
+        trace_reader_t *reader = trace_reader_create(replay_stream);
+        if (reader == NULL) {
+            perror(replay_filename);
+            exit(EXIT_FAILURE);
+        }
+
+        replay = replay_create(reader, blob_store, replay_first, replay_last);
+        if (replay == NULL) {
+            fprintf(stderr, "%s: %s:%llu: %s\n", argv[0], replay_filename,
+                    (unsigned long long)trace_reader_get_line(reader), strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        trace_reader_destroy(reader);
+        fclose(replay_stream);
+        if (replay_get_num_missing(replay) != 0 && io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            fprintf(stderr, "%s: warning: %llu strings written are not available and are replayed as zeros\n",
+                    argv[0], (unsigned long long)replay_get_num_missing(replay));
+        }
+    }
+
+    int log_file = (console == NULL) && (output != NULL || recorder == NULL);
+    if (log_file && output == NULL && num_loggers > 1) {
+        fprintf(stderr, "%s: multiple workers require an output file\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (async_log) {
+        logger = logger_create(log_overflow);
+        if (logger == NULL) {
+            perror("logger_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    worker_t *workers = (worker_t *)aligned_alloc(_Alignof(worker_t), num_workers * sizeof(*workers));
+    if (workers == NULL) {
+        perror("aligned_alloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(workers, 0, num_workers * sizeof(*workers));
+    for (size_t i = 0; i < num_workers; ++i) {
+        worker_t *worker = &workers[i];
+        worker->id = i;
+        worker->cpu = (cpus != NULL) ? cpus[(pipeline > 0) ? ((i + 1) % num_workers) : i] : -1;
+        worker->seed = seed + i;
+        worker->tsc_frequency = tsc_frequency;
+        if (pipeline == 0 || i == pipeline) {
+            worker->priority = sched_fifo;
+            if (worker->cpu != -1 && io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+                int flags = cpu_get_isolation(worker->cpu);
+                if ((flags & CPU_ISOLATED) == 0) {
+                    fprintf(stderr, "%s: warning: CPU %d is not isolated (isolcpus)\n", argv[0], worker->cpu);
+                }
+
+                if ((flags & CPU_NOHZ_FULL) == 0) {
+                    fprintf(stderr, "%s: warning: CPU %d is not in adaptive-tick mode (nohz_full)\n", argv[0],
+                            worker->cpu);
+                }
+            }
+        }
+
+        if (pipeline > 0 && i == pipeline) {
+            worker->generators = workers;
+            worker->num_generators = pipeline;
+            io_fuzzer_message(IO_FUZZER_LOG_VERBOSE, "%s: executor: cpu %d, %zu generators\n", argv[0], worker->cpu,
+                    worker->num_generators);
+        }
+
+        worker->console = console;
+        /* The records of all workers are interleaved in the debug console. */
+        worker->print_worker = (num_workers > 1);
+        worker->log_stream = (log_file && segment_size == 0) ? stream : NULL;
+        if (output != NULL && num_workers > 1 && segment_size == 0) {
+            char filename[PATH_MAX];
+            snprintf(filename, sizeof(filename), "%s.%zu", output, i);
+            worker->log_stream = fopen(filename, "a+");
+            if (worker->log_stream == NULL) {
+                perror("fopen");
+                goto err;
+            }
+        }
+
+        worker->io_fuzzer = io_fuzzer_create(ports, num_ports);
+        if (worker->io_fuzzer == NULL) {
+            perror("io_fuzzer_create");
+            goto err;
+        }
+
+        io_fuzzer_set_clock(worker->io_fuzzer, &tsc_clock);
+        size_t max_responses = race ? race_length : ((pipeline > 0 && i == pipeline) ? PIPELINE_MAX_OPERATIONS : 1);
+        if (io_fuzzer_set_capture(worker->io_fuzzer, capture, max_responses) == -1) {
+            perror("io_fuzzer_set_capture");
+            goto err;
+        }
+
+        trace_header_init(&worker->header, i, worker->seed);
+        if (blob_store != NULL) {
+            worker->header.flags |= TRACE_FLAG_PAYLOAD_HASH;
+        }
+
+        io_fuzzer_log_handler_t *log_handler = binary ? binary_log_handler : default_log_handler;
+        if (console != NULL) {
+            commit_init(&worker->commit, -1, COMMIT_NONE, 0);
+            log_handler = binary ? binary_console_log_handler : default_console_log_handler;
+            if (binary) {
+                console_write(console, &worker->header, sizeof(worker->header));
+            }
+        } else if (log_file && segment_size != 0) {
+            char filename[PATH_MAX];
+            snprintf(filename, sizeof(filename), (num_workers > 1) ? "%s.%zu" : "%s", output, i);
+            worker->segments = segment_writer_create(
+                    filename, segment_size, max_segments, &worker->header, binary ? sizeof(worker->header) : 0);
+            if (worker->segments == NULL) {
+                perror("segment_writer_create");
+                goto err;
+            }
+
+            commit_init(&worker->commit, -1, sync_policy, sync_interval);
+            commit_set_flush(&worker->commit, worker_flush, worker);
+            log_handler = binary ? binary_segment_log_handler : default_segment_log_handler;
+        } else if (log_file) {
+            commit_init(&worker->commit, fileno(worker->log_stream), sync_policy, sync_interval);
+            commit_set_flush(&worker->commit, worker_flush, worker);
+        } else {
+            commit_init(&worker->commit, -1, COMMIT_NONE, 0);
+        }
+
+        if (binary && worker->log_stream != NULL) {
+            worker->writer = trace_writer_create(fileno(worker->log_stream), &worker->header);
+            if (worker->writer == NULL) {
+                perror("trace_writer_create");
+                goto err;
+            }
+        }
+
+        void *log_context = worker;
+        if (logger != NULL && (log_file || console != NULL)) {
+            worker->channel = logger_add_channel(logger, LOG_RING_SLOTS, log_handler, log_context);
+            if (worker->channel == NULL) {
+                perror("logger_add_channel");
+                goto err;
+            }
+
+            log_handler = logger_log;
+            log_context = worker->channel;
+        }
+
+        if (blob_store != NULL || recorder != NULL) {
+            worker->blob_store = blob_store;
+            if (blob_store != NULL) {
+                worker->blob_buffer = blob_buffer_create(blob_store);
+                if (worker->blob_buffer == NULL) {
+                    perror("blob_buffer_create");
+                    goto err;
+                }
+            }
+
+            if (recorder != NULL) {
+                worker->recorder_ring = recorder_get_ring(recorder, i);
+                worker->recorder_ring->header = worker->header;
+            }
+
+            worker->log_handler = (log_file || console != NULL) ? log_handler : NULL;
+            worker->log_context = log_context;
+            log_handler = worker_log_handler;
+            log_context = worker;
+        }
+
+        io_fuzzer_set_log_handler(worker->io_fuzzer, log_handler);
+        io_fuzzer_set_log_context(worker->io_fuzzer, log_context);
+
+        initstate_r(worker->seed, worker->random_state, sizeof(worker->random_state), &worker->random_data);
+        io_fuzzer_message(IO_FUZZER_LOG_VERBOSE, "%s: worker %zu: cpu %d, seed %lu, %zu ports, %s log%s\n", argv[0], i,
+                worker->cpu, worker->seed, num_ports, binary ? "binary" : "JSON",
+                (worker->channel != NULL) ? " (async)" : "");
+        if (race) {
+            worker->operations = (io_fuzzer_operation_t *)calloc(race_length, sizeof(*worker->operations));
+            if (worker->operations == NULL) {
+                perror("calloc");
+                goto err;
+            }
+
+            uint8_t *strings = (uint8_t *)malloc(race_length * IO_FUZZER_MAX_STRING);
+            if (strings == NULL) {
+                perror("malloc");
+                goto err;
+            }
+
+            for (size_t j = 0; j < race_length; ++j) {
+                worker->operations[j].string = strings + (j * IO_FUZZER_MAX_STRING);
+            }
+
+            worker->num_operations = race_length;
+            worker->skew = skew;
+        }
+
+        worker->num_fibers = fibers;
+        worker->max_polls = fiber_polls;
+
+        if (pipeline > 0 && i != pipeline) {
+            worker->ring = ring_create(PIPELINE_SLOTS, program_size(PIPELINE_MAX_OPERATIONS, PIPELINE_CAPACITY));
+            if (worker->ring == NULL) {
+                perror("ring_create");
+                goto err;
+            }
+        }
+    }
+
+    if (sync_policy == COMMIT_INTERVAL) {
+        committer = committer_create(sync_interval);
+        if (committer == NULL) {
+            perror("committer_create");
+            goto err;
+        }
+
+        for (size_t i = 0; i < num_workers; ++i) {
+            if (workers[i].commit.policy == COMMIT_INTERVAL && committer_add(committer, &workers[i].commit) == -1) {
+                perror("committer_add");
+                goto err;
+            }
+        }
+
+        if (committer_start(committer) == -1) {
+            perror("committer_start");
+            goto err;
+        }
+    }
+
+    if (export_directory != NULL) {
+        exporter = exporter_create(export_directory, export_interval);
+        if (exporter == NULL) {
+            perror("exporter_create");
+            goto err;
+        }
+
+        /* The strings are exported first, so that the exported records refer to strings that are exported too. */
+        if (blob_filename != NULL && exporter_add_file(exporter, blob_filename) == -1) {
+            perror(blob_filename);
+            goto err;
+        }
+
+        for (size_t i = 0; i < num_workers; ++i) {
+            if (workers[i].log_stream == NULL) {
+                continue;
+            }
+
+            char filename[PATH_MAX];
+            snprintf(filename, sizeof(filename), (num_workers > 1) ? "%s.%zu" : "%s", output, i);
+            if (exporter_add_file(exporter, filename) == -1) {
+                perror(filename);
+                goto err;
+            }
+        }
+
+        if (exporter_start(exporter) == -1) {
+            perror("exporter_start");
+            goto err;
+        }
+    }
+
+    if (lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall");
+        goto err;
+    }
+
+    worker_pool_t pool = {.workers = workers, .num_workers = num_workers};
+    if (logger != NULL) {
+        /* On abort, the logger thread writes the records published so far and then the buffers of the workers. */
+        logger_set_flush_handler(logger, workers_flush, &pool);
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = abort_handler;
+        sigaction(SIGABRT, &action, NULL);
+        if (logger_start(logger) == -1) {
+            perror("logger_start");
+            goto err;
+        }
+    }
+
+    if (generate) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stop_handler;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        if (num_workers == 1) {
+            if (fibers > 0) {
+                worker_fibers(&workers[0]);
+            } else {
+                worker_run(&workers[0]);
+            }
+        } else {
+            for (size_t i = 0; i < num_workers; ++i) {
+                void *(*start_routine)(void *) = race ? worker_race : ((fibers > 0) ? worker_fibers : worker_run);
+                if (pipeline > 0) {
+                    start_routine = (i == pipeline) ? worker_execute : worker_generate;
+                }
+
+                int error = pthread_create(&workers[i].thread, NULL, start_routine, &workers[i]);
+                if (error != 0) {
+                    errno = error;
+                    perror("pthread_create");
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            for (size_t i = 0; i < num_workers; ++i) {
+                pthread_join(workers[i].thread, NULL);
+            }
+        }
+
+        if (logger != NULL) {
+            logger_stop(logger);
+            for (size_t i = 0; i < num_workers; ++i) {
+                if (workers[i].channel != NULL) {
+                    workers[i].drops = logger_channel_get_drops(workers[i].channel);
+                }
+            }
+        }
+
+        if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            print_summary(stderr, workers, (pipeline > 0) ? pipeline : jobs);
+            if (pipeline > 0) {
+                print_executor_summary(stderr, &workers[pipeline]);
+            }
+
+            if (blob_store != NULL) {
+                uint64_t num_blobs = 0;
+                uint64_t num_bytes = 0;
+                uint64_t num_duplicates = 0;
+                blob_store_get_stats(blob_store, &num_blobs, &num_bytes, &num_duplicates);
+                fprintf(stderr, "blob store: %llu blobs stored, %llu bytes, %llu duplicates\n",
+                        (unsigned long long)num_blobs, (unsigned long long)num_bytes,
+                        (unsigned long long)num_duplicates);
+            }
+        }
+    } else if (replay != NULL) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stop_handler;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        worker_replay(&workers[0], replay, repeat, &replay_timing);
+        if (io_fuzzer_log_enabled(IO_FUZZER_LOG_NORMAL)) {
+            print_replay_summary(stderr, &workers[0], replay, &replay_timing);
+        }
+    } else {
+        if (argv[optind] != NULL) {
+            input = argv[optind];
+        }
+
+        FILE *stream = stdin;
+        if (input != NULL) {
+            FILE *stream = fopen(input, "r");
+            if (stream == NULL) {
+                perror("fopen");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        worker_begin(&workers[0]);
+        io_fuzzer_iterate(workers[0].io_fuzzer, stream);
+        worker_end(&workers[0]);
+        fclose(stream);
+    }
+
+    logger_destroy(logger);
+    committer_destroy(committer);
+    destroy_workers(workers, num_workers, stream);
+    console_destroy(console);
+    recorder_destroy(recorder);
+    replay_destroy(replay);
+    blob_store_destroy(blob_store);
+    if (blob_fd != -1) {
+        close(blob_fd);
+    }
+
+    fflush(stream);
+    if (exporter != NULL) {
+        if (exporter_stop(exporter) == -1) {
+            perror("exporter_stop");
+        } else {
+            io_fuzzer_message(IO_FUZZER_LOG_NORMAL, "export: %llu bytes exported to %s\n",
+                    (unsigned long long)exporter_get_bytes(exporter), export_directory);
+        }
+
+        exporter_destroy(exporter);
+    }
+
+    fclose(stream);
+    free(cpus);
+    free(ports);
+    exit(EXIT_SUCCESS);
+
+err:
+    exporter_destroy(exporter);
+    logger_destroy(logger);
+    committer_destroy(committer);
+    destroy_workers(workers, num_workers, stream);
+    console_destroy(console);
+    recorder_destroy(recorder);
+    replay_destroy(replay);
+    blob_store_destroy(blob_store);
+    if (blob_fd != -1) {
+        close(blob_fd);
+    }
 
-err:
-    io_fuzzer_destroy(io_fuzzer);
     fclose(stream);
+    free(cpus);
     free(ports);
     exit(EXIT_FAILURE);
 }
@@ -0,0 +1,234 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "lib/trace.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGRAM_NAME "iofuzzer-merge"
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]... FILE...\n" \
+            "Merge trace files (binary or JSON lines) of multiple workers into JSON lines ordered by time.\n" \
+            "Options:\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -o, --output=FILE     Specify the output file name.\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+/** Trace file being merged, with its next record. */
+typedef struct _segment {
+    FILE *stream;
+    trace_reader_t *reader;
+    const char *filename;
+    size_t number;
+    trace_header_t header;
+    trace_record_t record;
+} segment_t;
+
+static int
+segment_read(segment_t *restrict segment)
+{
+    int result = trace_reader_read(segment->reader, &segment->record);
+    if (result == -1) {
+        fprintf(stderr, "%s:%llu: %s\n", segment->filename,
+                (unsigned long long)trace_reader_get_line(segment->reader), strerror(errno));
+        return -1;
+    }
+
+    /* JSON lines have no header, so their worker is the number of the file. */
+    uint32_t worker = segment->header.worker;
+    segment->header = *trace_reader_get_header(segment->reader);
+    segment->header.worker = worker;
+    return result;
+}
+
+static inline int
+segment_less(const segment_t *a, const segment_t *b)
+{
+    if (a->record.time != b->record.time) {
+        return a->record.time < b->record.time;
+    }
+
+    if (a->number != b->number) {
+        return a->number < b->number;
+    }
+
+    return a->record.sequence < b->record.sequence;
+}
+
+static void
+heap_sift_down(segment_t **heap, size_t size, size_t i)
+{
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < size && segment_less(heap[left], heap[smallest])) {
+            smallest = left;
+        }
+
+        if (right < size && segment_less(heap[right], heap[smallest])) {
+            smallest = right;
+        }
+
+        if (smallest == i) {
+            return;
+        }
+
+        segment_t *segment = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = segment;
+        i = smallest;
+    }
+}
+
+int
+merge(segment_t *segments, size_t num_segments, FILE *restrict output)
+{
+    segment_t **heap = (segment_t **)calloc(num_segments, sizeof(*heap));
+    if (heap == NULL) {
+        return -1;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < num_segments; ++i) {
+        int result = segment_read(&segments[i]);
+        if (result == -1) {
+            free(heap);
+            return -1;
+        }
+
+        if (result == 1) {
+            heap[size++] = &segments[i];
+        }
+    }
+
+    for (size_t i = size / 2; i-- > 0;) {
+        heap_sift_down(heap, size, i);
+    }
+
+    while (size > 0) {
+        segment_t *segment = heap[0];
+        trace_record_print_json_worker(output, &segment->header, &segment->record);
+        int result = segment_read(segment);
+        if (result == -1) {
+            free(heap);
+            return -1;
+        }
+
+        if (result == 0) {
+            heap[0] = heap[--size];
+        }
+
+        heap_sift_down(heap, size, 0);
+    }
+
+    free(heap);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"help",        no_argument,       NULL, 'h'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    char *output = NULL;
+    while ((c = getopt_long(argc, argv, "ho:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind == argc) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num_segments = argc - optind;
+    segment_t *segments = (segment_t *)calloc(num_segments, sizeof(*segments));
+    if (segments == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num_segments; ++i) {
+        segment_t *segment = &segments[i];
+        segment->filename = argv[optind + i];
+        segment->number = i;
+        segment->stream = fopen(segment->filename, "r");
+        if (segment->stream == NULL) {
+            perror(segment->filename);
+            exit(EXIT_FAILURE);
+        }
+
+        segment->reader = trace_reader_create(segment->stream);
+        if (segment->reader == NULL) {
+            perror(segment->filename);
+            exit(EXIT_FAILURE);
+        }
+
+        segment->header = *trace_reader_get_header(segment->reader);
+        if (trace_reader_is_json(segment->reader)) {
+            segment->header.worker = i;
+        }
+    }
+
+    FILE *stream = stdout;
+    if (output != NULL) {
+        stream = fopen(output, "w");
+        if (stream == NULL) {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int status = (merge(segments, num_segments, stream) == -1) ? EXIT_FAILURE : EXIT_SUCCESS;
+    for (size_t i = 0; i < num_segments; ++i) {
+        trace_reader_destroy(segments[i].reader);
+        fclose(segments[i].stream);
+    }
+
+    free(segments);
+    fclose(stream);
+    exit(status);
+}
@@ -0,0 +1,757 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "lib/blob.h"
+#include "lib/io_fuzzer.h"
+#include "lib/replay.h"
+#include "lib/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PROGRAM_NAME "iofuzzer-min"
+
+#define PLACEHOLDER "{}" /**< Argument of the command replaced by the file name of the candidate trace. */
+
+#define CACHE_CAPACITY 1024 /**< Initial capacity of the cache of results. */
+#define POLL_INTERVAL_MS 10 /**< Interval between checks of whether a timed command exited. */
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]... -o OUTPUT FILE COMMAND [ARG]...\n" \
+            "Minimize the operations of a trace that still crashes, as told by the exit status of\n" \
+            "the command (0 if the candidate trace, whose file name replaces the {} argument or\n" \
+            "is appended to the arguments, still crashes).\n" \
+            "Options:\n" \
+            "      --blob-store=FILE Read the strings written from (and store the strings of the\n" \
+            "                        candidates in) the specified blob store. (Required if the\n" \
+            "                        trace has strings written.)\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -o, --output=FILE     Specify the output file name.\n" \
+            "  -r, --range=FIRST[-LAST]\n" \
+            "                        Specify the indexes of the first and last operations of\n" \
+            "                        the trace to minimize. (The default is all operations.)\n" \
+            "  -t, --timeout=NUM     Specify the timeout, in seconds, of each command, after\n" \
+            "                        which the candidate is considered not to crash. (The\n" \
+            "                        default is 0, for no timeout.)\n" \
+            "  -v, --verbose         Enable verbose mode (print the progress and the output of\n" \
+            "                        the command).\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+/** Operation of a candidate, with the hash of its string. */
+typedef struct _min_operation {
+    io_fuzzer_operation_t operation; /**< Operation. */
+    uint64_t hash;                   /**< Hash of the string written (0 if none). */
+    uint64_t time;                   /**< Time of the operation in the trace. */
+} min_operation_t;
+
+/** Minimizer. */
+typedef struct _minimizer {
+    char **argv;
+    char *filename;
+    int fd;
+    unsigned long timeout;
+    int verbose;
+    blob_store_t *blob_store;
+    trace_header_t header;
+    uint64_t *keys;
+    uint8_t *results;
+    size_t cache_size;
+    size_t cache_capacity;
+    uint64_t num_tests;
+    uint64_t num_cached;
+} minimizer_t;
+
+static uint8_t *zeros = NULL;
+
+static int
+is_write_string(int function)
+{
+    return function == IO_FUZZER_IO_WRITE_STRING16 || function == IO_FUZZER_IO_WRITE_STRING32
+            || function == IO_FUZZER_IO_WRITE_STRING8;
+}
+
+static uint64_t
+candidate_hash(const min_operation_t *operations, size_t num_operations)
+{
+    uint64_t hash = num_operations;
+    for (size_t i = 0; i < num_operations; ++i) {
+        const io_fuzzer_operation_t *operation = &operations[i].operation;
+        uint64_t key[4] = {hash, ((uint64_t)operation->function << 16) | operation->port,
+                ((uint64_t)operation->count << 32) | operation->value, operations[i].hash};
+        hash = blob_hash(key, sizeof(key));
+    }
+
+    /* 0 marks the empty slots of the cache. */
+    return (hash != 0) ? hash : 1;
+}
+
+static int
+cache_lookup(const minimizer_t *restrict minimizer, uint64_t key, int *result)
+{
+    size_t mask = minimizer->cache_capacity - 1;
+    for (size_t i = key & mask; minimizer->keys[i] != 0; i = (i + 1) & mask) {
+        if (minimizer->keys[i] == key) {
+            *result = minimizer->results[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+cache_insert(minimizer_t *restrict minimizer, uint64_t key, int result)
+{
+    if ((minimizer->cache_size + 1) * 2 > minimizer->cache_capacity) {
+        size_t capacity = minimizer->cache_capacity * 2;
+        uint64_t *keys = (uint64_t *)calloc(capacity, sizeof(*keys));
+        uint8_t *results = (uint8_t *)calloc(capacity, sizeof(*results));
+        if (keys == NULL || results == NULL) {
+            free(results);
+            free(keys);
+            return -1;
+        }
+
+        for (size_t i = 0; i < minimizer->cache_capacity; ++i) {
+            if (minimizer->keys[i] != 0) {
+                size_t j = minimizer->keys[i] & (capacity - 1);
+                while (keys[j] != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+
+                keys[j] = minimizer->keys[i];
+                results[j] = minimizer->results[i];
+            }
+        }
+
+        free(minimizer->results);
+        free(minimizer->keys);
+        minimizer->keys = keys;
+        minimizer->results = results;
+        minimizer->cache_capacity = capacity;
+    }
+
+    size_t mask = minimizer->cache_capacity - 1;
+    size_t i = key & mask;
+    while (minimizer->keys[i] != 0) {
+        i = (i + 1) & mask;
+    }
+
+    minimizer->keys[i] = key;
+    minimizer->results[i] = result;
+    ++minimizer->cache_size;
+    return 0;
+}
+
+/**
+ * Writes a candidate to the file of the candidate traces.
+ *
+ * @return 0 on success; otherwise, -1 and errno is set to indicate the error.
+ */
+static int
+candidate_write(minimizer_t *restrict minimizer, const min_operation_t *operations, size_t num_operations)
+{
+    if (ftruncate(minimizer->fd, 0) == -1 || lseek(minimizer->fd, 0, SEEK_SET) == -1) {
+        return -1;
+    }
+
+    trace_writer_t *writer = trace_writer_create(minimizer->fd, &minimizer->header);
+    if (writer == NULL) {
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < num_operations && result == 0; ++i) {
+        const io_fuzzer_operation_t *operation = &operations[i].operation;
+        trace_record_t record;
+        memset(&record, 0, sizeof(record));
+        record.sequence = i;
+        record.time = operations[i].time;
+        record.payload = operations[i].hash;
+        record.value = operation->value;
+        record.count = operation->count;
+        record.port = operation->port;
+        record.function = operation->function;
+        record.width = io_fuzzer_function_width(operation->function);
+        result = trace_writer_write(writer, &record);
+    }
+
+    if (result == 0) {
+        result = trace_writer_flush(writer);
+    }
+
+    trace_writer_destroy(writer);
+    return result;
+}
+
+/**
+ * Runs the command on the file of the candidate traces.
+ *
+ * @return 1 if the candidate still crashes, 0 if it does not, or -1 and errno
+ *   is set to indicate the error.
+ */
+static int
+command_run(minimizer_t *restrict minimizer)
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        return -1;
+    }
+
+    if (pid == 0) {
+        if (!minimizer->verbose) {
+            int fd = open("/dev/null", O_RDWR);
+            if (fd != -1) {
+                dup2(fd, STDIN_FILENO);
+                dup2(fd, STDOUT_FILENO);
+                dup2(fd, STDERR_FILENO);
+            }
+        }
+
+        execvp(minimizer->argv[0], minimizer->argv);
+        _exit(127);
+    }
+
+    int status = 0;
+    if (minimizer->timeout == 0) {
+        while (waitpid(pid, &status, 0) == -1) {
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+    } else {
+        struct timespec interval = {0, POLL_INTERVAL_MS * 1000000L};
+        unsigned long elapsed = 0;
+        pid_t result = 0;
+        while ((result = waitpid(pid, &status, WNOHANG)) == 0) {
+            if (elapsed >= minimizer->timeout * 1000) {
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                return 0;
+            }
+
+            nanosleep(&interval, NULL);
+            elapsed += POLL_INTERVAL_MS;
+        }
+
+        if (result == -1) {
+            return -1;
+        }
+    }
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Tests whether a candidate still crashes, looking up the result of
+ * candidates with the same operations already tested first.
+ *
+ * @return 1 if the candidate still crashes, 0 if it does not, or -1 and errno
+ *   is set to indicate the error.
+ */
+static int
+candidate_test(minimizer_t *restrict minimizer, const min_operation_t *operations, size_t num_operations)
+{
+    uint64_t key = candidate_hash(operations, num_operations);
+    int result = 0;
+    if (cache_lookup(minimizer, key, &result)) {
+        ++minimizer->num_cached;
+        return result;
+    }
+
+    if (candidate_write(minimizer, operations, num_operations) == -1) {
+        return -1;
+    }
+
+    result = command_run(minimizer);
+    if (result == -1 || cache_insert(minimizer, key, result) == -1) {
+        return -1;
+    }
+
+    ++minimizer->num_tests;
+    if (minimizer->verbose) {
+        fprintf(stderr, "%s: test %llu: %zu operations: %s\n", PROGRAM_NAME, (unsigned long long)minimizer->num_tests,
+                num_operations, result ? "crashes" : "does not crash");
+    }
+
+    return result;
+}
+
+/**
+ * Finds the shortest prefix that still crashes with a binary search. (Crashes
+ * are caused by the operations before them, so the operations after the first
+ * crash can be removed with a logarithmic number of tests.)
+ */
+static ssize_t
+minimize_prefix(minimizer_t *restrict minimizer, const min_operation_t *operations, size_t num_operations)
+{
+    size_t low = 0;
+    size_t high = num_operations;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        int result = candidate_test(minimizer, operations, middle);
+        if (result == -1) {
+            return -1;
+        }
+
+        if (result) {
+            high = middle;
+        } else {
+            low = middle;
+        }
+    }
+
+    return high;
+}
+
+/**
+ * Removes the operations that are not needed to crash with the ddmin
+ * algorithm, testing chunks of the operations and their complements at
+ * increasing granularity.
+ */
+static ssize_t
+minimize_ddmin(minimizer_t *restrict minimizer, min_operation_t *operations, size_t num_operations)
+{
+    if (num_operations < 2) {
+        return num_operations;
+    }
+
+    min_operation_t *candidate = (min_operation_t *)malloc(num_operations * sizeof(*candidate));
+    if (candidate == NULL) {
+        return -1;
+    }
+
+    size_t granularity = 2;
+    while (num_operations >= 2) {
+        size_t chunk = (num_operations + granularity - 1) / granularity;
+        int reduced = 0;
+        for (size_t i = 0; i < granularity && !reduced; ++i) {
+            size_t begin = i * chunk;
+            size_t end = (begin + chunk < num_operations) ? (begin + chunk) : num_operations;
+            if (begin >= end) {
+                break;
+            }
+
+            /* Chunks are their own complements' complements when there are only two of them. */
+            int result = (granularity == 2) ? 0 : candidate_test(minimizer, operations + begin, end - begin);
+            if (result == 1) {
+                memmove(operations, operations + begin, (end - begin) * sizeof(*operations));
+                num_operations = end - begin;
+                granularity = 2;
+                reduced = 1;
+                break;
+            }
+
+            size_t size = 0;
+            memcpy(candidate, operations, begin * sizeof(*candidate));
+            size += begin;
+            memcpy(candidate + size, operations + end, (num_operations - end) * sizeof(*candidate));
+            size += num_operations - end;
+            if (result == 0) {
+                result = candidate_test(minimizer, candidate, size);
+            }
+
+            if (result == -1) {
+                free(candidate);
+                return -1;
+            }
+
+            if (result == 1) {
+                memcpy(operations, candidate, size * sizeof(*operations));
+                num_operations = size;
+                granularity = (granularity > 2) ? (granularity - 1) : 2;
+                reduced = 1;
+            }
+        }
+
+        if (!reduced) {
+            if (granularity >= num_operations) {
+                break;
+            }
+
+            granularity = (granularity * 2 < num_operations) ? (granularity * 2) : num_operations;
+        }
+    }
+
+    free(candidate);
+    return num_operations;
+}
+
+static int
+set_string(minimizer_t *restrict minimizer, min_operation_t *restrict operation, void *string, size_t count)
+{
+    operation->operation.string = string;
+    operation->operation.count = count;
+    operation->hash = 0;
+    size_t size = io_fuzzer_operation_size(&operation->operation);
+    if (minimizer->blob_store != NULL && is_write_string(operation->operation.function) && size != 0) {
+        return blob_store_put(minimizer->blob_store, string, size, &operation->hash);
+    }
+
+    return 0;
+}
+
+/**
+ * Shrinks the operations left, keeping each change that still crashes:
+ * values written are replaced by 0, strings are halved, and strings written
+ * are replaced by zeros.
+ */
+static int
+minimize_values(minimizer_t *restrict minimizer, min_operation_t *operations, size_t num_operations)
+{
+    for (size_t i = 0; i < num_operations; ++i) {
+        min_operation_t *operation = &operations[i];
+        min_operation_t original = *operation;
+        int result = 0;
+        switch (operation->operation.function) {
+        case IO_FUZZER_IO_WRITE16:
+        case IO_FUZZER_IO_WRITE32:
+        case IO_FUZZER_IO_WRITE8:
+            if (operation->operation.value == 0) {
+                break;
+            }
+
+            operation->operation.value = 0;
+            if ((result = candidate_test(minimizer, operations, num_operations)) != 1) {
+                *operation = original;
+            }
+
+            break;
+
+        case IO_FUZZER_IO_READ_STRING16:
+        case IO_FUZZER_IO_READ_STRING32:
+        case IO_FUZZER_IO_READ_STRING8:
+        case IO_FUZZER_IO_WRITE_STRING16:
+        case IO_FUZZER_IO_WRITE_STRING32:
+        case IO_FUZZER_IO_WRITE_STRING8:
+            while (operation->operation.count > 1 && result != -1) {
+                original = *operation;
+                if (set_string(minimizer, operation, operation->operation.string, operation->operation.count / 2)
+                        == -1) {
+                    return -1;
+                }
+
+                if ((result = candidate_test(minimizer, operations, num_operations)) != 1) {
+                    *operation = original;
+                    break;
+                }
+            }
+
+            if (result == -1 || !is_write_string(operation->operation.function)) {
+                break;
+            }
+
+            original = *operation;
+            if (set_string(minimizer, operation, zeros, operation->operation.count) == -1) {
+                return -1;
+            }
+
+            if (operation->hash != original.hash
+                    && (result = candidate_test(minimizer, operations, num_operations)) != 1) {
+                *operation = original;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+
+        if (result == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_BLOB_STORE = CHAR_MAX + 1,
+        OPT_VERSION,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"blob-store",  required_argument, NULL, OPT_BLOB_STORE  },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"range",       required_argument, NULL, 'r'             },
+        {"timeout",     required_argument, NULL, 't'             },
+        {"verbose",     no_argument,       NULL, 'v'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    char *blob_filename = NULL;
+    char *output = NULL;
+    uint64_t first = 0;
+    uint64_t last = UINT64_MAX;
+    minimizer_t minimizer;
+    memset(&minimizer, 0, sizeof(minimizer));
+    minimizer.fd = -1;
+    /* The options of the command are not options of the minimizer. */
+    while ((c = getopt_long(argc, argv, "+ho:r:t:v", longopts, &longindex)) != -1) {
+        switch (c) {
+        case OPT_BLOB_STORE:
+            blob_filename = optarg;
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'r': {
+            char *end = NULL;
+            errno = 0;
+            first = strtoull(optarg, &end, 0);
+            if (errno == 0 && end != optarg && *end == '-') {
+                const char *str = end + 1;
+                last = strtoull(str, &end, 0);
+                if (end == str) {
+                    errno = EINVAL;
+                }
+            }
+
+            if (errno != 0 || end == optarg || *end != '\0' || first > last) {
+                fprintf(stderr, "%s: invalid range -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+        }
+
+        case 't':
+            errno = 0;
+            minimizer.timeout = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'v':
+            minimizer.verbose = 1;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (output == NULL || argc - optind < 2) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    const char *filename = argv[optind++];
+    int blob_fd = -1;
+    if (blob_filename != NULL) {
+        blob_fd = open(blob_filename, O_RDWR | O_CREAT, 0666);
+        if (blob_fd == -1) {
+            perror(blob_filename);
+            exit(EXIT_FAILURE);
+        }
+
+        minimizer.blob_store = blob_store_create(blob_fd);
+        if (minimizer.blob_store == NULL) {
+            perror("blob_store_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    FILE *stream = fopen(filename, "r");
+    if (stream == NULL) {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+
+    trace_reader_t *reader = trace_reader_create(stream);
+    if (reader == NULL) {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+
+    replay_t *replay = replay_create(reader, minimizer.blob_store, first, last);
+    if (replay == NULL) {
+        fprintf(stderr, "%s: %s:%llu: %s\n", argv[0], filename, (unsigned long long)trace_reader_get_line(reader),
+                strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    trace_reader_destroy(reader);
+    fclose(stream);
+    if (replay_get_num_missing(replay) != 0) {
+        fprintf(stderr, "%s: warning: %llu strings written are not available and are written as zeros\n", argv[0],
+                (unsigned long long)replay_get_num_missing(replay));
+    }
+
+    size_t num_operations = 0;
+    const io_fuzzer_operation_t *replay_operations = replay_get_operations(replay, &num_operations);
+    const uint64_t *times = replay_get_times(replay);
+
+    /* Without a blob store, the candidates would refer to no string, and every string would be replayed as zeros. */
+    if (minimizer.blob_store == NULL) {
+        size_t num_strings = 0;
+        for (size_t i = 0; i < num_operations; ++i) {
+            if (is_write_string(replay_operations[i].function) && replay_operations[i].count != 0) {
+                ++num_strings;
+            }
+        }
+
+        if (num_strings != 0) {
+            fprintf(stderr, "%s: %s has %zu strings written, which require a blob store (see --blob-store)\n",
+                    argv[0], filename, num_strings);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    min_operation_t *operations = (min_operation_t *)calloc(num_operations + 1, sizeof(*operations));
+    zeros = (uint8_t *)calloc(1, IO_FUZZER_MAX_STRING);
+    minimizer.cache_capacity = CACHE_CAPACITY;
+    minimizer.keys = (uint64_t *)calloc(minimizer.cache_capacity, sizeof(*minimizer.keys));
+    minimizer.results = (uint8_t *)calloc(minimizer.cache_capacity, sizeof(*minimizer.results));
+    if (operations == NULL || zeros == NULL || minimizer.keys == NULL || minimizer.results == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num_operations; ++i) {
+        operations[i].operation = replay_operations[i];
+        operations[i].time = times[i];
+        if (is_write_string(replay_operations[i].function)
+                && set_string(&minimizer, &operations[i], replay_operations[i].string, replay_operations[i].count)
+                        == -1) {
+            perror("blob_store_put");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    trace_header_init(&minimizer.header, 0, 0);
+    if (minimizer.blob_store != NULL) {
+        minimizer.header.flags |= TRACE_FLAG_PAYLOAD_HASH;
+    }
+
+    const char *tmpdir = getenv("TMPDIR");
+    if (tmpdir == NULL || *tmpdir == '\0') {
+        tmpdir = "/tmp";
+    }
+
+    size_t size = strlen(tmpdir) + sizeof("/" PROGRAM_NAME ".XXXXXX");
+    minimizer.filename = (char *)malloc(size);
+    int num_args = argc - optind;
+    minimizer.argv = (char **)calloc(num_args + 2, sizeof(*minimizer.argv));
+    if (minimizer.filename == NULL || minimizer.argv == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(minimizer.filename, size, "%s/%s.XXXXXX", tmpdir, PROGRAM_NAME);
+    minimizer.fd = mkstemp(minimizer.filename);
+    if (minimizer.fd == -1) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+
+    int has_placeholder = 0;
+    for (int i = 0; i < num_args; ++i) {
+        minimizer.argv[i] = argv[optind + i];
+        if (strcmp(minimizer.argv[i], PLACEHOLDER) == 0) {
+            minimizer.argv[i] = minimizer.filename;
+            has_placeholder = 1;
+        }
+    }
+
+    if (!has_placeholder) {
+        minimizer.argv[num_args] = minimizer.filename;
+    }
+
+    int status = EXIT_SUCCESS;
+    size_t num_original = num_operations;
+    int result = candidate_test(&minimizer, operations, num_operations);
+    ssize_t num_left = num_operations;
+    if (result == 0) {
+        fprintf(stderr, "%s: %s does not crash\n", argv[0], filename);
+        status = EXIT_FAILURE;
+    } else if (result == -1 || (num_left = minimize_prefix(&minimizer, operations, num_operations)) == -1
+               || (num_left = minimize_ddmin(&minimizer, operations, num_left)) == -1
+               || minimize_values(&minimizer, operations, num_left) == -1) {
+        perror(minimizer.argv[0]);
+        status = EXIT_FAILURE;
+    }
+
+    if (status == EXIT_SUCCESS) {
+        int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1) {
+            perror(output);
+            status = EXIT_FAILURE;
+        } else {
+            int output_fd = minimizer.fd;
+            minimizer.fd = fd;
+            if (candidate_write(&minimizer, operations, num_left) == -1) {
+                perror(output);
+                status = EXIT_FAILURE;
+            }
+
+            minimizer.fd = output_fd;
+            close(fd);
+        }
+
+        fprintf(stderr, "min: %zu operations minimized to %zd, %llu tests, %llu cached\n", num_original, num_left,
+                (unsigned long long)minimizer.num_tests, (unsigned long long)minimizer.num_cached);
+    }
+
+    close(minimizer.fd);
+    unlink(minimizer.filename);
+    free(minimizer.argv);
+    free(minimizer.filename);
+    free(minimizer.results);
+    free(minimizer.keys);
+    free(zeros);
+    free(operations);
+    replay_destroy(replay);
+    blob_store_destroy(minimizer.blob_store);
+    if (blob_fd != -1) {
+        close(blob_fd);
+    }
+
+    exit(status);
+}
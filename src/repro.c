@@ -0,0 +1,504 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "../lib/string.h"
+#include "lib/blob.h"
+#include "lib/input.h"
+#include "lib/io_fuzzer.h"
+#include "lib/replay.h"
+#include "lib/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#define PROGRAM_NAME "iofuzzer-repro"
+
+#define MAX_PORTS 65536
+
+#define STRING_COLUMNS 12 /**< Number of bytes per line of the strings emitted. */
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]... [FILE]...\n" \
+            "Compile a trace (or crashing inputs) into a self-contained C program (or QEMU qtest\n" \
+            "script) that performs the same operations.\n" \
+            "Options:\n" \
+            "      --blob-store=FILE Read the strings written from the specified blob store.\n" \
+            "  -f, --format=FORMAT   Specify the output format (i.e., c or qtest). (The default\n" \
+            "                        is c.)\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -i, --input           Decode the files as inputs (one operation each) instead\n" \
+            "                        of a trace.\n" \
+            "  -o, --output=FILE     Specify the output file name.\n" \
+            "  -p, --ports=LIST      Specify the list of I/O port addresses the inputs were\n" \
+            "                        decoded with. (The default is all ports.)\n" \
+            "  -r, --range=FIRST[-LAST]\n" \
+            "                        Specify the indexes of the first and last operations of\n" \
+            "                        the trace to perform. (The default is all operations.)\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+/** Calls of sys/io.h that perform each function. */
+static const char *function_calls[IO_FUZZER_NUM_FUNCTIONS] = {
+    "inw",
+    "inl",
+    "inb",
+    "insw",
+    "insl",
+    "insb",
+    "outw",
+    "outl",
+    "outb",
+    "outsw",
+    "outsl",
+    "outsb",
+};
+
+/** qtest commands that perform each value of each function. */
+static const char *qtest_commands[IO_FUZZER_NUM_FUNCTIONS] = {
+    "inw",
+    "inl",
+    "inb",
+    "inw",
+    "inl",
+    "inb",
+    "outw",
+    "outl",
+    "outb",
+    "outw",
+    "outl",
+    "outb",
+};
+
+static const char *input_name = NULL;
+
+void
+input_error_handler(int status, int error, const char *restrict format, va_list ap)
+{
+    fprintf(stderr, "%s: %s: input too short\n", PROGRAM_NAME, input_name);
+    exit(EXIT_FAILURE);
+}
+
+static int
+is_write_string(int function)
+{
+    return function == IO_FUZZER_IO_WRITE_STRING16 || function == IO_FUZZER_IO_WRITE_STRING32
+            || function == IO_FUZZER_IO_WRITE_STRING8;
+}
+
+static int
+is_read_string(int function)
+{
+    return function == IO_FUZZER_IO_READ_STRING16 || function == IO_FUZZER_IO_READ_STRING32
+            || function == IO_FUZZER_IO_READ_STRING8;
+}
+
+static void
+emit_string(FILE *restrict output, size_t index, const uint8_t *string, size_t size)
+{
+    fprintf(output, "static const uint8_t string%zu[%zu] __attribute__((aligned(4))) = {", index, size);
+    for (size_t i = 0; i < size; ++i) {
+        fprintf(output, "%s0x%02x,", (i % STRING_COLUMNS == 0) ? "\n    " : " ", string[i]);
+    }
+
+    fprintf(output, "\n};\n\n");
+}
+
+int
+repro(FILE *restrict output, const char *source, const io_fuzzer_operation_t *operations, size_t num_operations)
+{
+    fprintf(output,
+            "/*\n"
+            " * Generated by %s (%s) from %s (%zu operations).\n"
+            " *\n"
+            " * Build with `cc -O2 -o repro repro.c` and run as root (or with CAP_SYS_RAWIO)\n"
+            " * on the machine under test.\n"
+            " */\n"
+            "\n"
+            "#include <stdint.h>\n"
+            "#include <stdio.h>\n"
+            "#include <stdlib.h>\n"
+            "\n"
+            "#include <sys/io.h>\n"
+            "\n",
+            PROGRAM_NAME, PACKAGE_STRING, source, num_operations);
+
+    /* Strings read are discarded, so they all share a buffer as large as the largest one. */
+    size_t buffer_size = 0;
+    size_t num_strings = 0;
+    for (size_t i = 0; i < num_operations; ++i) {
+        const io_fuzzer_operation_t *operation = &operations[i];
+        size_t size = io_fuzzer_operation_size(operation);
+        if (is_read_string(operation->function) && size > buffer_size) {
+            buffer_size = size;
+        } else if (is_write_string(operation->function) && size != 0) {
+            emit_string(output, num_strings++, (const uint8_t *)operation->string, size);
+        }
+    }
+
+    if (buffer_size != 0) {
+        fprintf(output, "static uint8_t buffer[%zu] __attribute__((aligned(4)));\n\n", buffer_size);
+    }
+
+    fprintf(output,
+            "int\n"
+            "main(void)\n"
+            "{\n"
+            "    if (iopl(3) == -1) {\n"
+            "        perror(\"iopl\");\n"
+            "        exit(EXIT_FAILURE);\n"
+            "    }\n"
+            "\n");
+    num_strings = 0;
+    for (size_t i = 0; i < num_operations; ++i) {
+        const io_fuzzer_operation_t *operation = &operations[i];
+        const char *call = function_calls[operation->function];
+        switch (operation->function) {
+        case IO_FUZZER_IO_READ16:
+        case IO_FUZZER_IO_READ32:
+        case IO_FUZZER_IO_READ8:
+            fprintf(output, "    %s(%#x);\n", call, operation->port);
+            break;
+
+        case IO_FUZZER_IO_READ_STRING16:
+        case IO_FUZZER_IO_READ_STRING32:
+        case IO_FUZZER_IO_READ_STRING8:
+            fprintf(output, "    %s(%#x, %s, %zu);\n", call, operation->port,
+                    (operation->count != 0) ? "buffer" : "NULL", operation->count);
+            break;
+
+        case IO_FUZZER_IO_WRITE16:
+        case IO_FUZZER_IO_WRITE32:
+        case IO_FUZZER_IO_WRITE8:
+            /* The value comes first in sys/io.h. */
+            fprintf(output, "    %s(%#x, %#x);\n", call, operation->value, operation->port);
+            break;
+
+        case IO_FUZZER_IO_WRITE_STRING16:
+        case IO_FUZZER_IO_WRITE_STRING32:
+        case IO_FUZZER_IO_WRITE_STRING8:
+            if (operation->count == 0) {
+                fprintf(output, "    %s(%#x, NULL, 0);\n", call, operation->port);
+            } else {
+                fprintf(output, "    %s(%#x, string%zu, %zu);\n", call, operation->port, num_strings++,
+                        operation->count);
+            }
+
+            break;
+
+        default:
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    fprintf(output,
+            "%s"
+            "    exit(EXIT_SUCCESS);\n"
+            "}\n",
+            (num_operations != 0) ? "\n" : "");
+    return ferror(output) ? -1 : 0;
+}
+
+int
+qtest(FILE *restrict output, const io_fuzzer_operation_t *operations, size_t num_operations)
+{
+    for (size_t i = 0; i < num_operations; ++i) {
+        const io_fuzzer_operation_t *operation = &operations[i];
+        const char *command = qtest_commands[operation->function];
+        size_t width = io_fuzzer_function_width(operation->function);
+        switch (operation->function) {
+        case IO_FUZZER_IO_READ16:
+        case IO_FUZZER_IO_READ32:
+        case IO_FUZZER_IO_READ8:
+            fprintf(output, "%s %#x\n", command, operation->port);
+            break;
+
+        case IO_FUZZER_IO_READ_STRING16:
+        case IO_FUZZER_IO_READ_STRING32:
+        case IO_FUZZER_IO_READ_STRING8:
+            /* qtest has no string instructions, so rep ins and rep outs are unrolled. */
+            for (size_t j = 0; j < operation->count; ++j) {
+                fprintf(output, "%s %#x\n", command, operation->port);
+            }
+
+            break;
+
+        case IO_FUZZER_IO_WRITE16:
+        case IO_FUZZER_IO_WRITE32:
+        case IO_FUZZER_IO_WRITE8:
+            fprintf(output, "%s %#x %#x\n", command, operation->port, operation->value);
+            break;
+
+        case IO_FUZZER_IO_WRITE_STRING16:
+        case IO_FUZZER_IO_WRITE_STRING32:
+        case IO_FUZZER_IO_WRITE_STRING8:
+            for (size_t j = 0; j < operation->count; ++j) {
+                uint32_t value = 0;
+                memcpy(&value, (const uint8_t *)operation->string + (j * width), width);
+                fprintf(output, "%s %#x %#x\n", command, operation->port, value);
+            }
+
+            break;
+
+        default:
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return ferror(output) ? -1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_BLOB_STORE = CHAR_MAX + 1,
+        OPT_VERSION,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"blob-store",  required_argument, NULL, OPT_BLOB_STORE  },
+        {"format",      required_argument, NULL, 'f'             },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"input",       no_argument,       NULL, 'i'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"ports",       required_argument, NULL, 'p'             },
+        {"range",       required_argument, NULL, 'r'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    char *blob_filename = NULL;
+    char *format = NULL;
+    int input = 0;
+    char *output = NULL;
+    int *ports = NULL;
+    size_t num_ports = 0;
+    uint64_t first = 0;
+    uint64_t last = UINT64_MAX;
+    while ((c = getopt_long(argc, argv, "f:hio:p:r:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case OPT_BLOB_STORE:
+            blob_filename = optarg;
+            break;
+
+        case 'f':
+            if (strcmp(optarg, "c") != 0 && strcmp(optarg, "qtest") != 0) {
+                fprintf(stderr, "%s: invalid format -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            format = optarg;
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'i':
+            input = 1;
+            break;
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'p':
+            if (string_split_range(optarg, ",", MAX_PORTS, &ports, &num_ports) == -1) {
+                perror("string_split_range");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'r': {
+            char *end = NULL;
+            errno = 0;
+            first = strtoull(optarg, &end, 0);
+            if (errno == 0 && end != optarg && *end == '-') {
+                const char *str = end + 1;
+                last = strtoull(str, &end, 0);
+                if (end == str) {
+                    errno = EINVAL;
+                }
+            }
+
+            if (errno != 0 || end == optarg || *end != '\0' || first > last) {
+                fprintf(stderr, "%s: invalid range -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+        }
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (input && (optind == argc || blob_filename != NULL || first != 0 || last != UINT64_MAX)) {
+        fprintf(stderr, "%s: input mode requires input files, and no blob store or range\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!input && (argc - optind > 1 || ports != NULL)) {
+        fprintf(stderr, "%s: a trace requires a single file and no list of ports\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    io_fuzzer_operation_t *operations = NULL;
+    size_t num_operations = 0;
+    replay_t *replay = NULL;
+    char source[PATH_MAX];
+    if (input) {
+        io_fuzzer_t *io_fuzzer = io_fuzzer_create(ports, num_ports);
+        operations = (io_fuzzer_operation_t *)calloc(argc - optind, sizeof(*operations));
+        uint8_t *string = (uint8_t *)malloc(IO_FUZZER_MAX_STRING);
+        if (io_fuzzer == NULL || operations == NULL || string == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        input_set_error_handler(input_error_handler);
+        for (int i = optind; i < argc; ++i) {
+            FILE *stream = fopen(argv[i], "r");
+            if (stream == NULL) {
+                perror(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+
+            input_name = argv[i];
+            io_fuzzer_operation_t *operation = &operations[num_operations++];
+            operation->string = string;
+            io_fuzzer_decode(io_fuzzer, stream, operation);
+            fclose(stream);
+            size_t size = io_fuzzer_operation_size(operation);
+            operation->string = malloc(size);
+            if (operation->string == NULL && size != 0) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
+            }
+
+            if (size != 0) {
+                memcpy(operation->string, string, size);
+            }
+        }
+
+        free(string);
+        io_fuzzer_destroy(io_fuzzer);
+        if (num_operations == 1) {
+            snprintf(source, sizeof(source), "%s", argv[optind]);
+        } else {
+            snprintf(source, sizeof(source), "%zu inputs", num_operations);
+        }
+    } else {
+        int blob_fd = -1;
+        blob_store_t *blob_store = NULL;
+        if (blob_filename != NULL) {
+            blob_fd = open(blob_filename, O_RDONLY);
+            if (blob_fd == -1) {
+                perror(blob_filename);
+                exit(EXIT_FAILURE);
+            }
+
+            blob_store = blob_store_create(blob_fd);
+            if (blob_store == NULL) {
+                perror("blob_store_create");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        const char *filename = (optind < argc) ? argv[optind] : NULL;
+        FILE *stream = stdin;
+        if (filename != NULL) {
+            stream = fopen(filename, "r");
+            if (stream == NULL) {
+                perror(filename);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        trace_reader_t *reader = trace_reader_create(stream);
+        if (reader == NULL) {
+            perror((filename != NULL) ? filename : "stdin");
+            exit(EXIT_FAILURE);
+        }
+
+        replay = replay_create(reader, blob_store, first, last);
+        if (replay == NULL) {
+            fprintf(stderr, "%s: %s:%llu: %s\n", argv[0], (filename != NULL) ? filename : "stdin",
+                    (unsigned long long)trace_reader_get_line(reader), strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        trace_reader_destroy(reader);
+        fclose(stream);
+        blob_store_destroy(blob_store);
+        if (blob_fd != -1) {
+            close(blob_fd);
+        }
+
+        if (replay_get_num_missing(replay) != 0) {
+            fprintf(stderr, "%s: warning: %llu strings written are not available and are written as zeros\n",
+                    argv[0], (unsigned long long)replay_get_num_missing(replay));
+        }
+
+        operations = (io_fuzzer_operation_t *)replay_get_operations(replay, &num_operations);
+        snprintf(source, sizeof(source), "%s", (filename != NULL) ? filename : "stdin");
+    }
+
+    FILE *stream = stdout;
+    if (output != NULL) {
+        stream = fopen(output, "w");
+        if (stream == NULL) {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int status = EXIT_SUCCESS;
+    int result = (format != NULL && strcmp(format, "qtest") == 0) ? qtest(stream, operations, num_operations)
+                                                                   : repro(stream, source, operations, num_operations);
+    if (result == -1 || fflush(stream) == EOF) {
+        perror("repro");
+        status = EXIT_FAILURE;
+    }
+
+    if (replay != NULL) {
+        replay_destroy(replay);
+    } else {
+        for (size_t i = 0; i < num_operations; ++i) {
+            free(operations[i].string);
+        }
+
+        free(operations);
+    }
+
+    free(ports);
+    fclose(stream);
+    exit(status);
+}
@@ -0,0 +1,582 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "lib/archive.h"
+#include "lib/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#define PROGRAM_NAME "iofuzzer-trace"
+
+#define SEEK_COUNT 16
+#define DIVERGE_COUNT 1 /**< Default number of records printed before the divergence. */
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s [OPTION]... COMMAND FILE...\n" \
+            "Pack binary trace files into archives, and print records from archives as JSON lines.\n" \
+            "Commands:\n" \
+            "  pack                  Pack the binary trace file into the output archive.\n" \
+            "  cat                   Print the records of the archives.\n" \
+            "  seek                  Print the records at and after the specified sequence number or\n" \
+            "                        time.\n" \
+            "  grep                  Print the records that match the specified port or function.\n" \
+            "  diverge               Print the first operation or response record where the two\n" \
+            "                        archives diverge (exiting with 1, or with 0 if they do not).\n" \
+            "Options:\n" \
+            "  -b, --block-size=NUM  Specify the number of records of each block.\n" \
+            "  -F, --function=NAME   Specify the function of the records to print.\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -n, --count=NUM       Specify the maximum number of records to print.\n" \
+            "  -o, --output=FILE     Specify the output file name.\n" \
+            "  -p, --port=PORT       Specify the I/O port address of the records to print.\n" \
+            "  -s, --sequence=NUM    Specify the sequence number of the first record to print.\n" \
+            "  -t, --time=NUM        Specify the time, in nanoseconds since the epoch, of the\n" \
+            "                        first record to print.\n" \
+            "      --version         Display version information and exit.\n", \
+            PROGRAM_NAME)
+
+#define version() fprintf(stderr, "%s (%s)\n", PROGRAM_NAME, PACKAGE_STRING)
+
+/** Position in the operation and response records of an archive. */
+typedef struct _cursor {
+    archive_t *archive;
+    const archive_header_t *header;
+    trace_record_t *records;
+    ssize_t num_records;
+    ssize_t index;
+    size_t block;
+    uint64_t position;
+    uint64_t digest;
+} cursor_t;
+
+/** Selection of the records to print. */
+typedef struct _selection {
+    int by_sequence;
+    uint64_t sequence;
+    int by_time;
+    uint64_t time;
+    long port;
+    int function;
+    uint64_t count;
+} selection_t;
+
+int
+pack(FILE *restrict input, int fd, size_t block_records)
+{
+    trace_header_t header;
+    if (trace_read_header(input, &header) == -1) {
+        return -1;
+    }
+
+    archive_writer_t *writer = archive_writer_create(fd, &header, block_records);
+    if (writer == NULL) {
+        return -1;
+    }
+
+    trace_record_t record;
+    int result = 0;
+    while ((result = trace_read_record(input, &header, &record)) == 1) {
+        if (archive_writer_write(writer, &record) == -1) {
+            result = -1;
+            break;
+        }
+    }
+
+    if (result == 0) {
+        result = archive_writer_finish(writer);
+    }
+
+    archive_writer_destroy(writer);
+    return result;
+}
+
+int
+print(int fd, FILE *restrict output, selection_t *restrict selection)
+{
+    archive_t *archive = archive_open(fd);
+    if (archive == NULL) {
+        return -1;
+    }
+
+    const archive_header_t *header = archive_get_header(archive);
+    trace_record_t *records = (trace_record_t *)calloc(header->block_records, sizeof(*records));
+    if (records == NULL) {
+        archive_close(archive);
+        return -1;
+    }
+
+    size_t num_blocks = 0;
+    archive_get_index(archive, &num_blocks);
+    size_t block = 0;
+    if (selection->by_sequence) {
+        block = archive_find_sequence(archive, selection->sequence);
+    } else if (selection->by_time) {
+        block = archive_find_time(archive, selection->time);
+    }
+
+    int result = 0;
+    for (; block < num_blocks && selection->count > 0; ++block) {
+        ssize_t num_records = archive_read_block(archive, block, records);
+        if (num_records == -1) {
+            result = -1;
+            break;
+        }
+
+        for (ssize_t i = 0; i < num_records && selection->count > 0; ++i) {
+            const trace_record_t *record = &records[i];
+            if ((selection->by_sequence && record->sequence < selection->sequence)
+                    || (selection->by_time && record->time < selection->time)
+                    || (selection->port != -1 && record->port != selection->port)
+                    || (selection->function != -1 && record->function != selection->function)) {
+                continue;
+            }
+
+            trace_record_print_json(output, &header->trace, record);
+            --selection->count;
+        }
+    }
+
+    free(records);
+    archive_close(archive);
+    return result;
+}
+
+static int
+cursor_open(cursor_t *restrict cursor, int fd)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->archive = archive_open(fd);
+    if (cursor->archive == NULL) {
+        return -1;
+    }
+
+    cursor->header = archive_get_header(cursor->archive);
+    cursor->records = (trace_record_t *)calloc(cursor->header->block_records, sizeof(*cursor->records));
+    if (cursor->records == NULL) {
+        archive_close(cursor->archive);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+cursor_close(cursor_t *restrict cursor)
+{
+    free(cursor->records);
+    archive_close(cursor->archive);
+}
+
+/**
+ * Reads the next operation or response record, chaining it into the digest.
+ *
+ * @return 1 on success, 0 at the end of the archive, or -1 and errno is set to
+ *   indicate the error.
+ */
+static int
+cursor_next(cursor_t *restrict cursor, trace_record_t *restrict record)
+{
+    size_t num_blocks = 0;
+    archive_get_index(cursor->archive, &num_blocks);
+    for (;;) {
+        while (cursor->index < cursor->num_records) {
+            *record = cursor->records[cursor->index++];
+            if (archive_digest(&cursor->header->trace, record, &cursor->digest)) {
+                ++cursor->position;
+                return 1;
+            }
+        }
+
+        if (cursor->block >= num_blocks) {
+            return 0;
+        }
+
+        cursor->num_records = archive_read_block(cursor->archive, cursor->block++, cursor->records);
+        cursor->index = 0;
+        if (cursor->num_records == -1) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Moves to the operation or response record at the position, decoding only the
+ * block that has it.
+ *
+ * @return 1 on success, 0 if the archive has fewer records, or -1 and errno is
+ *   set to indicate the error.
+ */
+static int
+cursor_seek(cursor_t *restrict cursor, uint64_t position)
+{
+    size_t num_blocks = 0;
+    const archive_index_t *index = archive_get_index(cursor->archive, &num_blocks);
+    cursor->block = archive_find_position(cursor->archive, position);
+    cursor->num_records = 0;
+    cursor->index = 0;
+    cursor->position = (num_blocks != 0) ? index[cursor->block].position : 0;
+    cursor->digest = (num_blocks != 0) ? index[cursor->block].digest : 0;
+    trace_record_t record;
+    while (cursor->position < position) {
+        int result = cursor_next(cursor, &record);
+        if (result != 1) {
+            return result;
+        }
+    }
+
+    return 1;
+}
+
+static void
+print_divergence(FILE *restrict output, const char *prefix, const cursor_t *restrict cursor, int result,
+        const trace_record_t *restrict record)
+{
+    fprintf(output, "%s", prefix);
+    if (result == 1) {
+        trace_record_print_json(output, &cursor->header->trace, record);
+    } else {
+        fprintf(output, "end of archive\n");
+    }
+}
+
+/**
+ * Finds the first operation or response record where the archives diverge.
+ * Since the digests in the index are chained, the archives have the same
+ * records up to a block if the digests at its start are the same, so the last
+ * block of the first archive where they do not diverge yet is found with a
+ * binary search, decoding a single block of the second archive for each step,
+ * and only the records from there on are compared.
+ *
+ * @return 1 if the archives diverge, 0 if they do not, or -1 and errno is set
+ *   to indicate the error.
+ */
+int
+diverge(int fd_a, int fd_b, FILE *restrict output, uint64_t count)
+{
+    cursor_t a;
+    cursor_t b;
+    if (cursor_open(&a, fd_a) == -1) {
+        return -1;
+    }
+
+    if (cursor_open(&b, fd_b) == -1) {
+        cursor_close(&a);
+        return -1;
+    }
+
+    size_t num_blocks = 0;
+    const archive_index_t *index = archive_get_index(a.archive, &num_blocks);
+    size_t low = 0;
+    size_t high = num_blocks;
+    int result = 0;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        result = cursor_seek(&b, index[middle].position);
+        if (result == -1) {
+            goto out;
+        }
+
+        if (result == 1 && b.digest == index[middle].digest) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    uint64_t position = (num_blocks != 0) ? index[low].position : 0;
+    if (cursor_seek(&a, position) == -1 || cursor_seek(&b, position) == -1) {
+        result = -1;
+        goto out;
+    }
+
+    trace_record_t record_a;
+    trace_record_t record_b;
+    int result_a = 0;
+    int result_b = 0;
+    for (;;) {
+        result_a = cursor_next(&a, &record_a);
+        result_b = cursor_next(&b, &record_b);
+        if (result_a == -1 || result_b == -1) {
+            result = -1;
+            goto out;
+        }
+
+        if (result_a == 0 && result_b == 0) {
+            fprintf(output, "no divergence (%llu operation and response records)\n", (unsigned long long)a.position);
+            result = 0;
+            goto out;
+        }
+
+        if (result_a == 0 || result_b == 0 || a.digest != b.digest) {
+            break;
+        }
+    }
+
+    position = ((result_a == 1) ? a.position : b.position) - 1;
+    fprintf(output, "divergence at operation or response record %llu\n", (unsigned long long)position);
+    print_divergence(output, "< ", &a, result_a, &record_a);
+    print_divergence(output, "> ", &b, result_b, &record_b);
+    if (count > 0) {
+        uint64_t first = (position > count) ? (position - count) : 0;
+        fprintf(output, "preceded by:\n");
+        trace_record_t record;
+        if (cursor_seek(&a, first) == -1) {
+            result = -1;
+            goto out;
+        }
+
+        while (a.position < position && (result = cursor_next(&a, &record)) == 1) {
+            print_divergence(output, "  ", &a, result, &record);
+        }
+
+        if (result == -1) {
+            goto out;
+        }
+    }
+
+    result = 1;
+
+out:
+    cursor_close(&b);
+    cursor_close(&a);
+    return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"block-size",  required_argument, NULL, 'b'             },
+        {"count",       required_argument, NULL, 'n'             },
+        {"function",    required_argument, NULL, 'F'             },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"port",        required_argument, NULL, 'p'             },
+        {"sequence",    required_argument, NULL, 's'             },
+        {"time",        required_argument, NULL, 't'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    size_t block_records = ARCHIVE_BLOCK_RECORDS;
+    char *output = NULL;
+    selection_t selection = {.port = -1, .function = -1, .count = UINT64_MAX};
+    int has_count = 0;
+    while ((c = getopt_long(argc, argv, "b:F:hn:o:p:s:t:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'b':
+            errno = 0;
+            block_records = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'F':
+            selection.function = trace_function_from_name(optarg);
+            if (selection.function == -1) {
+                fprintf(stderr, "%s: invalid function -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'n':
+            errno = 0;
+            selection.count = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            has_count = 1;
+            break;
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'p':
+            errno = 0;
+            selection.port = strtol(optarg, NULL, 0);
+            if (errno != 0 || selection.port < 0 || selection.port > UINT16_MAX) {
+                fprintf(stderr, "%s: invalid port -- '%s'\n", argv[0], optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 's':
+            errno = 0;
+            selection.sequence = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            selection.by_sequence = 1;
+            break;
+
+        case 't':
+            errno = 0;
+            selection.time = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            selection.by_time = 1;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind == argc) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    const char *command = argv[optind++];
+    if (strcmp(command, "pack") == 0) {
+        if (output == NULL || argc - optind > 1) {
+            fprintf(stderr, "%s: pack requires an output file and a single input file\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        FILE *input = stdin;
+        if (optind < argc) {
+            input = fopen(argv[optind], "r");
+            if (input == NULL) {
+                perror(argv[optind]);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1) {
+            perror("open");
+            exit(EXIT_FAILURE);
+        }
+
+        int status = EXIT_SUCCESS;
+        if (pack(input, fd, block_records) == -1) {
+            perror("pack");
+            status = EXIT_FAILURE;
+        }
+
+        close(fd);
+        fclose(input);
+        exit(status);
+    }
+
+    if (strcmp(command, "seek") == 0) {
+        if (!selection.by_sequence && !selection.by_time) {
+            fprintf(stderr, "%s: seek requires a sequence number or time\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!has_count) {
+            selection.count = SEEK_COUNT;
+        }
+    } else if (strcmp(command, "grep") == 0) {
+        if (selection.port == -1 && selection.function == -1) {
+            fprintf(stderr, "%s: grep requires a port or function\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(command, "diverge") == 0) {
+        if (argc - optind != 2) {
+            fprintf(stderr, "%s: diverge requires two archives\n", argv[0]);
+            exit(2);
+        }
+    } else if (strcmp(command, "cat") != 0) {
+        fprintf(stderr, "%s: invalid command -- '%s'\n", argv[0], command);
+        exit(EXIT_FAILURE);
+    }
+
+    if (optind == argc) {
+        fprintf(stderr, "%s: %s requires an archive\n", argv[0], command);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *stream = stdout;
+    if (output != NULL) {
+        stream = fopen(output, "w");
+        if (stream == NULL) {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (strcmp(command, "diverge") == 0) {
+        int fd_a = open(argv[optind], O_RDONLY);
+        int fd_b = open(argv[optind + 1], O_RDONLY);
+        if (fd_a == -1 || fd_b == -1) {
+            perror(argv[(fd_a == -1) ? optind : (optind + 1)]);
+            exit(2);
+        }
+
+        /* As with cmp, the status is 0 if the archives do not diverge, 1 if they do, and 2 on errors. */
+        int result = diverge(fd_a, fd_b, stream, has_count ? selection.count : DIVERGE_COUNT);
+        if (result == -1) {
+            perror("diverge");
+        }
+
+        close(fd_b);
+        close(fd_a);
+        fclose(stream);
+        exit((result == -1) ? 2 : result);
+    }
+
+    int status = EXIT_SUCCESS;
+    for (int i = optind; i < argc; ++i) {
+        int fd = open(argv[i], O_RDONLY);
+        if (fd == -1) {
+            perror(argv[i]);
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        if (print(fd, stream, &selection) == -1) {
+            perror(argv[i]);
+            status = EXIT_FAILURE;
+        }
+
+        close(fd);
+    }
+
+    fclose(stream);
+    exit(status);
+}